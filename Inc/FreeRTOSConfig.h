@@ -18,13 +18,25 @@
 extern uint32_t HAL_RCC_GetHCLKFreq(void);
 
 #define configUSE_PREEMPTION				1
+#define configSUPPORT_STATIC_ALLOCATION			1
+#define configSUPPORT_DYNAMIC_ALLOCATION		1
+#if configSUPPORT_STATIC_ALLOCATION
+/* Tasks and the RTOS objects of the network stack, including the netconn
+ * semaphores created on a thread's first socket call, come from static pools.
+ * Nothing in the firmware allocates from the heap, it is a reserve for
+ * application code. init_task publishes its minimum free size in
+ * g_heap_min_free. */
+#define configTOTAL_HEAP_SIZE				( ( size_t ) ( 4 * 1024 ) )
+#else
+#define configTOTAL_HEAP_SIZE				( ( size_t ) ( 75 * 1024 ) )
+#endif
 #define configUSE_IDLE_HOOK				0
 #define configUSE_TICK_HOOK				0
 #define configCPU_CLOCK_HZ				( HAL_RCC_GetHCLKFreq() )
 #define configTICK_RATE_HZ				( ( TickType_t ) 1000 )
 #define configMAX_PRIORITIES				( 5 )
 #define configMINIMAL_STACK_SIZE			( ( unsigned short ) 130 )
-#define configTOTAL_HEAP_SIZE				( ( size_t ) ( 75 * 1024 ) )
+#define configSTACK_DEPTH_TYPE				uint32_t
 #define configMAX_TASK_NAME_LEN				( 10 )
 #define configUSE_TRACE_FACILITY			1
 #define configUSE_16_BIT_TICKS				0
@@ -37,12 +49,32 @@ extern uint32_t HAL_RCC_GetHCLKFreq(void);
 #define configUSE_APPLICATION_TASK_TAG			0
 #define configUSE_COUNTING_SEMAPHORES			1
 #define configGENERATE_RUN_TIME_STATS			1
-#define configUSE_STATS_FORMATTING_FUNCTIONS		1
+#define configUSE_STATS_FORMATTING_FUNCTIONS		0
+/* Index 1 is left to the lwIP port (LWIP_FREERTOS_MBOX_NOTIFY_INDEX) */
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES		2
+/* Index 0 holds the lwIP per-thread netconn semaphore */
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS		1
+
+/* Set this to 1 to count task run time in CPU cycles with DWT->CYCCNT,
+ * extended to 64 bits, instead of with the 100 kHz TIM2 counter.
+ * TIM2 is started either way, sys_now() runs on it. */
+#ifndef RUN_TIME_STATS_DWT
+#define RUN_TIME_STATS_DWT				0
+#endif
 
 void tim2_init(void);
 uint32_t tim2_cnt(void);
+#if RUN_TIME_STATS_DWT
+void dwt_init(void);
+uint64_t dwt_cnt64(void);
+#define configRUN_TIME_COUNTER_TYPE			uint64_t
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()	do { tim2_init(); dwt_init(); } while (0)
+#define portGET_RUN_TIME_COUNTER_VALUE()		dwt_cnt64()
+#else
+#define configRUN_TIME_COUNTER_TYPE			uint32_t
 #define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()	tim2_init()
 #define portGET_RUN_TIME_COUNTER_VALUE()		tim2_cnt()
+#endif
 
 
 /* Co-routine definitions. */
@@ -64,6 +96,8 @@ to exclude the API function. */
 #define INCLUDE_vTaskSuspend				1
 #define INCLUDE_vTaskDelayUntil				1
 #define INCLUDE_vTaskDelay				1
+/* ulTaskGetIdleRunTimeCounter(), for the CPU load of iperf tests */
+#define INCLUDE_xTaskGetIdleTaskHandle			1
 
 /* Cortex-M specific definitions. */
 #ifdef __NVIC_PRIO_BITS
@@ -50,6 +50,15 @@ void sys_arch_msleep(u32_t delay_ms);
 
 #if SYS_LIGHTWEIGHT_PROT
 typedef u32_t sys_prot_t;
+
+#if LWIP_FREERTOS_SYS_ARCH_PROTECT_STATS
+struct sys_arch_protect_stats {
+  u32_t count;          /* outermost protected regions entered */
+  u32_t max_cycles;     /* longest region in CPU cycles */
+  uint64_t total_cycles; /* sum of all regions in CPU cycles */
+};
+void sys_arch_protect_get_stats(struct sys_arch_protect_stats *stats);
+#endif /* LWIP_FREERTOS_SYS_ARCH_PROTECT_STATS */
 #endif /* SYS_LIGHTWEIGHT_PROT */
 
 #if !LWIP_COMPAT_MUTEX
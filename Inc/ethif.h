@@ -4,11 +4,58 @@
 #include "lwip/err.h"
 #include "lwip/netif.h"
 
-enum link_status { LINK_UP, LINK_DOWN, LINK_UNCHANGED, LINK_ERROR };
+#include "ethphy.h"
+
+/** Set this to 1 to capture all received and transmitted frames for
+ * pcap_drain() and to enable pcap_replay(). Received frames are referenced
+ * in their RX pool buffers, at most PCAP_RING_SIZE at a time, transmitted
+ * frames are copied.
+ */
+#ifndef ETHIF_PCAP
+#define ETHIF_PCAP		0
+#endif
+
+/** Set this to 1 to run the MAC system time from ethptp_init() and to
+ * timestamp frames in hardware. Every received frame gets the time its start
+ * of frame delimiter passed the MAC, see ethif_rx_timestamp(). PTP event
+ * messages sent over UDP/IPv4 get their transmit time reported to
+ * ptp_tx_timestamp(). Requires ETHIF_TX_QUEUED. Must be set on the compiler
+ * command line, stm32f4xx_hal_conf.h enables HAL_ETH_USE_PTP from it.
+ */
+#ifndef ETHIF_PTP
+#define ETHIF_PTP		0
+#endif
+
+/** Maximum number of received frames handed to the tcpip thread in one
+ * message by ethif_input_batch(). Bounds how long one dispatch keeps the
+ * tcpip thread from the other messages in its mailbox.
+ */
+#ifndef ETHIF_RX_BATCH
+#define ETHIF_RX_BATCH		8U
+#endif
+
+struct ethptp_time;
+
+struct ethif_rx_pool_stats {
+	uint32_t size;		/* number of buffers in the pool */
+	uint32_t used;		/* buffers currently owned by DMA or lwIP */
+	uint32_t high_water;	/* maximum of used since boot */
+	uint32_t exhausted;	/* allocations failed due to empty pool */
+};
 
 void ethmac_init(void);
 err_t ethernetif_init(struct netif *netif);
 struct pbuf *low_level_input(struct netif *netif);
+void ethif_wait_rx(void);
+u32_t ethif_input_batch(struct netif *netif);
+void ethif_get_rx_pool_stats(struct ethif_rx_pool_stats *stats);
+#if ETHIF_PCAP
+struct pbuf *ethif_rx_pbuf(const void *data, uint16_t len);
+#endif
+#if ETHIF_PTP
+int ethif_rx_timestamp(const struct pbuf *p, struct ethptp_time *ts);
+#endif
 enum link_status ethphy_getlink(void);
+enum link_status ethphy_wait_link(void);
 
 #endif /* ETHERNET_INTERFACE_H */
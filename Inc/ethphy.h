@@ -0,0 +1,85 @@
+#ifndef ETHPHY_H
+#define ETHPHY_H
+
+#include "stm32f4xx_hal.h"
+
+#define ETH_PHY_ADDR				0U
+
+/* IEEE 802.3 clause 22 registers */
+#define PHY_BASIC_CONTROL			((uint16_t)0x0000)
+#define PHY_BASIC_STATUS			((uint16_t)0x0001)
+#define PHY_IDENTIFIER1				((uint16_t)0x0002)
+#define PHY_IDENTIFIER2				((uint16_t)0x0003)
+#define PHY_AUTONEG_ADVERTISEMENT		((uint16_t)0x0004)
+#define PHY_AUTONEG_LINK_PARTNER_ABILITY	((uint16_t)0x0005)
+#define PHY_AUTONEG_EXPANSION			((uint16_t)0x0006)
+#define PHY_AUTONEG_NEXT_PAGE			((uint16_t)0x0007)
+#define PHY_LINK_PARTNER_NEXT_PAGE_ABILITY	((uint16_t)0x0008)
+
+/* KSZ8081 vendor specific registers */
+#define PHY_DIGITAL_RESERVED_CONTROL		((uint16_t)0x0010)
+#define PHY_AFE_CONTROL1			((uint16_t)0x0011)
+#define PHY_RX_ERROR_COUNTER			((uint16_t)0x0015)
+#define PHY_OPERATION_MODE_STRAP_OVERRIDE	((uint16_t)0x0016)
+#define PHY_OPERATION_MODE_STRAP_STATUS		((uint16_t)0x0017)
+#define PHY_EXPANDED_CONTROL			((uint16_t)0x0018)
+#define PHY_INTERRUPT_CONTROL			((uint16_t)0x001B)
+#define PHY_INTERRUPT_STATUS			((uint16_t)0x001B)
+#define PHY_LINKMD_CONTROL			((uint16_t)0x001D)
+#define PHY_LINKMD_STATUS			((uint16_t)0x001D)
+#define PHY_CONTROL1				((uint16_t)0x001E)
+#define PHY_CONTROL2				((uint16_t)0x001F)
+
+/* Clause 22 masks */
+#define PHY_AUTONEG_RESTART			((uint16_t)0x0200)
+#define PHY_AUTONEG_ENABLE			((uint16_t)0x1000)
+#define PHY_FULLDUPLEX_SELECT			((uint16_t)0x0100)
+#define PHY_SPEED_100M_SELECT			((uint16_t)0x2000)
+#define PHY_LINKED_STATUS			((uint16_t)0x0004)
+#define PHY_AUTONEG_COMPLETE			((uint16_t)0x0020)
+#define PHY_ABILITY_100BASE_TX_FD		((uint16_t)0x0100)
+#define PHY_ABILITY_100BASE_TX			((uint16_t)0x0080)
+#define PHY_ABILITY_10BASE_T_FD			((uint16_t)0x0040)
+#define PHY_ABILITY_10BASE_T			((uint16_t)0x0020)
+
+/* KSZ8081 masks */
+#define PHY_REF_CLOCK_SELECT_MASK		((uint16_t)0x0080)
+#define PHY_REF_CLOCK_SELECT_25MHZ		((uint16_t)0x0080)
+#define PHY_LINK_INT_UP_OCCURRED		((uint16_t)0x0001)
+#define PHY_LINK_INT_DOWN_OCCURED		((uint16_t)0x0004)
+#define PHY_LINK_INT_UP_ENABLE			((uint16_t)0x0100)
+#define PHY_LINK_INT_DOWN_ENABLE		((uint16_t)0x0400)
+#define PHY_OPERATION_MODE_MASK			((uint16_t)0x0007)
+#define PHY_OPERATION_MODE_10BASE_T		((uint16_t)0x0001)
+#define PHY_OPERATION_MODE_100BASE_TX		((uint16_t)0x0002)
+#define PHY_OPERATION_MODE_10BASE_T_FD		((uint16_t)0x0005)
+#define PHY_OPERATION_MODE_100BASE_TX_FD	((uint16_t)0x0006)
+
+enum link_status { LINK_UP, LINK_DOWN, LINK_UNCHANGED, LINK_ERROR };
+
+/* Speed and duplex in terms of ETH_MACConfigTypeDef */
+struct ethphy_mode {
+	uint32_t speed;		/* ETH_SPEED_10M or ETH_SPEED_100M */
+	uint32_t duplex;	/* ETH_HALFDUPLEX_MODE or ETH_FULLDUPLEX_MODE */
+};
+
+struct ethphy_drv {
+	const char *name;
+	/* Link changes are signalled on the PHY interrupt pin */
+	int has_irq;
+	/* Prepares the PHY for autonegotiation and link change interrupts */
+	HAL_StatusTypeDef (*init)(ETH_HandleTypeDef *heth);
+	/* Current link state, LINK_UP or LINK_DOWN */
+	enum link_status (*get_link)(ETH_HandleTypeDef *heth);
+	/* Negotiated or forced speed and duplex of an established link */
+	HAL_StatusTypeDef (*get_mode)(ETH_HandleTypeDef *heth, struct ethphy_mode *mode);
+	/* Acknowledges the link change interrupt, LINK_UNCHANGED if nothing changed */
+	enum link_status (*irq_ack)(ETH_HandleTypeDef *heth);
+};
+
+extern const struct ethphy_drv ethphy_ksz8081;
+extern const struct ethphy_drv ethphy_generic;
+
+const struct ethphy_drv *ethphy_probe(ETH_HandleTypeDef *heth);
+
+#endif /* ETHPHY_H */
@@ -0,0 +1,25 @@
+#ifndef ETHPTP_H
+#define ETHPTP_H
+
+#include <stdint.h>
+
+#include "stm32f4xx_hal.h"
+
+/** Maximum frequency adjustment accepted by ethptp_adjust_freq(), in ppb */
+#ifndef ETHPTP_MAX_PPB
+#define ETHPTP_MAX_PPB		500000
+#endif
+
+/* Time of the MAC system time counter, nsec is below 1000000000 */
+struct ethptp_time {
+	uint32_t sec;
+	uint32_t nsec;
+};
+
+HAL_StatusTypeDef ethptp_init(ETH_HandleTypeDef *heth);
+HAL_StatusTypeDef ethptp_get_time(struct ethptp_time *time);
+HAL_StatusTypeDef ethptp_set_time(const struct ethptp_time *time);
+HAL_StatusTypeDef ethptp_adjust_offset(int64_t ns);
+HAL_StatusTypeDef ethptp_adjust_freq(int32_t ppb);
+
+#endif /* ETHPTP_H */
@@ -0,0 +1,46 @@
+#ifndef IPERF_H
+#define IPERF_H
+
+#include <stdint.h>
+
+/** Set this to a TCP and UDP port, usually 5001, to run an iperf2 compatible
+ * server on it. Dual (-d) and tradeoff (-r) tests make the board connect back
+ * to the client. 0 disables the server. Must be set on the compiler command
+ * line, lwipopts.h enables the MIB2 statistics from it.
+ */
+#ifndef IPERF_PORT
+#define IPERF_PORT		0U
+#endif
+
+/** Size of the static buffer transmitted by TCP and UDP send tests */
+#ifndef IPERF_TX_BUF_SIZE
+#define IPERF_TX_BUF_SIZE	1460U
+#endif
+
+enum iperf_test {
+	IPERF_TCP_RX,
+	IPERF_TCP_TX,
+	IPERF_UDP_RX,
+	IPERF_UDP_TX,
+	IPERF_TEST_CNT
+};
+
+struct iperf_report {
+	uint32_t seq;		/* incremented when a test finishes */
+	uint64_t bytes;		/* received, or acknowledged by the client for TCP TX */
+	uint32_t ms;		/* test duration */
+	uint32_t kbps;		/* bytes over ms, in kbit/s */
+	uint32_t retransmits;	/* TCP segments retransmitted during the test */
+	uint32_t datagrams;	/* UDP datagrams received or sent */
+	uint32_t lost;		/* UDP datagrams missing in the ID sequence */
+	uint32_t out_of_order;	/* UDP datagrams received with an ID lower than expected */
+	uint32_t jitter_us;	/* UDP transit time jitter, with sys_now() resolution */
+	uint16_t cpu_load;	/* non-idle CPU time during the test, in 0.01 % */
+};
+
+#if IPERF_PORT
+void iperf_init(void);
+void iperf_get_report(enum iperf_test test, struct iperf_report *report);
+#endif
+
+#endif /* IPERF_H */
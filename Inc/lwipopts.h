@@ -16,6 +16,17 @@
  */
 #define SYS_LIGHTWEIGHT_PROT    1
 
+/**
+ * LWIPOPTS_THROUGHPUT==1: size TCP for bulk transfers at line rate. The
+ * receive window, send buffer, heap and zero-copy RX pool grow by about
+ * 32 KB of SRAM, window scaling is negotiated, and out-of-order
+ * segments are queued and SACKed instead of being dropped. The default
+ * profile keeps the small footprint.
+ */
+#ifndef LWIPOPTS_THROUGHPUT
+#define LWIPOPTS_THROUGHPUT     0
+#endif
+
 /* ---------- Memory options ---------- */
 /* MEM_ALIGNMENT: should be set to the alignment of the CPU for which
    lwIP is compiled. 4 byte alignment -> define MEM_ALIGNMENT to 4, 2
@@ -24,7 +35,11 @@
 
 /* MEM_SIZE: the size of the heap memory. If the application will send
 a lot of data that needs to be copied, this should be set high. */
+#if LWIPOPTS_THROUGHPUT
+#define MEM_SIZE                (24*1024)
+#else
 #define MEM_SIZE                (10*1024)
+#endif
 
 /* MEMP_NUM_PBUF: the number of memp struct pbufs. If the application
    sends a lot of data out of ROM (or other static memory), this
@@ -41,7 +56,11 @@ a lot of data that needs to be copied, this should be set high. */
 #define MEMP_NUM_TCP_PCB_LISTEN 5
 /* MEMP_NUM_TCP_SEG: the number of simultaneously queued TCP
    segments. */
+#if LWIPOPTS_THROUGHPUT
+#define MEMP_NUM_TCP_SEG        (TCP_SND_QUEUELEN + TCP_OOSEQ_MAX_PBUFS)
+#else
 #define MEMP_NUM_TCP_SEG        12
+#endif
 /* MEMP_NUM_SYS_TIMEOUT: the number of simulateously active
    timeouts. */
 #define MEMP_NUM_SYS_TIMEOUT    10
@@ -57,19 +76,37 @@ a lot of data that needs to be copied, this should be set high. */
 /* ---------- IPv4 options ---------- */
 #define LWIP_IPV4                1
 
+/* ---------- IGMP options ---------- */
+/* Joined groups are programmed into the MAC address filter, see ethif.c */
+#define LWIP_IGMP                1
+
 /* ---------- TCP options ---------- */
 #define LWIP_TCP                1
 #define TCP_TTL                 255
 
 /* Controls if TCP should queue segments that arrive out of
    order. Define to 0 if your device is low on memory. */
+#if LWIPOPTS_THROUGHPUT
+#define TCP_QUEUE_OOSEQ         1
+/* Out-of-order segments hold zero-copy RX buffers (ETH_RX_BUFFER_CNT in
+   ethif.c). Keep enough of them free to receive the missing segment. */
+#define TCP_OOSEQ_MAX_PBUFS     8
+/* Tell the sender which segments were queued, so it only retransmits
+   the lost ones. */
+#define LWIP_TCP_SACK_OUT       1
+#else
 #define TCP_QUEUE_OOSEQ         0
+#endif
 
 /* TCP Maximum segment size. */
 #define TCP_MSS                 (1500 - 40)	  /* TCP_MSS = (Ethernet MTU - IP header size - TCP header size) */
 
 /* TCP sender buffer space (bytes). */
+#if LWIPOPTS_THROUGHPUT
+#define TCP_SND_BUF             (8*TCP_MSS)
+#else
 #define TCP_SND_BUF             (4*TCP_MSS)
+#endif
 
 /*  TCP_SND_QUEUELEN: TCP sender buffer space (pbufs). This must be at least
   as much as (2 * TCP_SND_BUF/TCP_MSS) for things to work. */
@@ -77,7 +114,22 @@ a lot of data that needs to be copied, this should be set high. */
 #define TCP_SND_QUEUELEN        (2* TCP_SND_BUF/TCP_MSS)
 
 /* TCP receive window. */
+#if LWIPOPTS_THROUGHPUT
+#define TCP_WND                 (12*TCP_MSS)
+/* Zero-copy RX buffers, the window plus room for ARP, ACKs and the
+   frames in flight in the DMA ring */
+#define ETH_RX_BUFFER_CNT       24U
+/* The window is checked against PBUF_POOL_SIZE, but received frames are
+   held in the zero-copy RX pool instead. ethif.c checks that the window
+   fits into that pool. */
+#define LWIP_DISABLE_TCP_SANITY_CHECKS 1
+/* Lets the peer advertise windows beyond 64 KB, and TCP_WND be raised past
+   64 KB without further changes */
+#define LWIP_WND_SCALE          1
+#define TCP_RCV_SCALE           2
+#else
 #define TCP_WND                 (2*TCP_MSS)
+#endif
 
 /* ---------- ARP options ----------- */
 #define LWIP_ARP                1
@@ -96,7 +148,25 @@ a lot of data that needs to be copied, this should be set high. */
 
 
 /* ---------- Statistics options ---------- */
+#if defined(IPERF_PORT) && IPERF_PORT
+/* The iperf server reports the TCP segments retransmitted during a test from
+   the MIB2 counters, the other statistics are left out */
+#define LWIP_STATS              1
+#define MIB2_STATS              1
+#define LINK_STATS              0
+#define ETHARP_STATS            0
+#define IP_STATS                0
+#define IPFRAG_STATS            0
+#define ICMP_STATS              0
+#define IGMP_STATS              0
+#define UDP_STATS               0
+#define TCP_STATS               0
+#define MEM_STATS               0
+#define MEMP_STATS              0
+#define SYS_STATS               0
+#else
 #define LWIP_STATS 0
+#endif
 
 /* ---------- link callback options ---------- */
 /* LWIP_NETIF_LINK_CALLBACK==1: Support a callback function from an interface
@@ -171,6 +241,13 @@ The STM32F7xxallows computing and verifying the IP, UDP, TCP and ICMP checksums
  */
 #define LWIP_SOCKET                     1
 
+/**
+ * LWIP_NETCONN_SEM_PER_THREAD==1: netconn and socket calls wait on one
+ * semaphore per task instead of one per netconn. It is created on the first
+ * call from a task, see sys_arch_netconn_sem_get().
+ */
+#define LWIP_NETCONN_SEM_PER_THREAD     1
+
 /*
    ---------------------------------
    ---------- OS options ----------
@@ -181,10 +258,76 @@ The STM32F7xxallows computing and verifying the IP, UDP, TCP and ICMP checksums
 #define TCPIP_THREAD_STACKSIZE          (configMINIMAL_STACK_SIZE * 8)
 #define TCPIP_MBOX_SIZE                 20
 #define DEFAULT_UDP_RECVMBOX_SIZE       6
+#if LWIPOPTS_THROUGHPUT
+/* One entry per received segment, a full window must fit */
+#define DEFAULT_TCP_RECVMBOX_SIZE       (TCP_WND / TCP_MSS)
+#else
 #define DEFAULT_TCP_RECVMBOX_SIZE       6
+#endif
 #define DEFAULT_ACCEPTMBOX_SIZE         6
 #define DEFAULT_THREAD_STACKSIZE        (configMINIMAL_STACK_SIZE)
 #define TCPIP_THREAD_PRIO               (1)
+
+/**
+ * LWIP_FREERTOS_SYS_NOW_FROM_FREERTOS==0: sys_now() is implemented in main.c
+ * on the free running TIM2 counter instead of the RTOS tick count.
+ */
+#define LWIP_FREERTOS_SYS_NOW_FROM_FREERTOS 0
+
+/**
+ * LWIP_FREERTOS_STATIC_ALLOCATION==1: create the tcpip thread, semaphores,
+ * mutexes and mboxes from static pools, see sys_arch.c for their sizes.
+ */
+#define LWIP_FREERTOS_STATIC_ALLOCATION configSUPPORT_STATIC_ALLOCATION
+
+/**
+ * LWIP_FREERTOS_SYS_ARCH_PROTECT_BASEPRI==1: SYS_ARCH_PROTECT() only masks
+ * interrupts up to LWIP_FREERTOS_SYS_ARCH_PROTECT_PRIO, the priority of the
+ * ETH and PHY interrupts (ETH_IRQ_PRIORITY in ethif.c), instead of all
+ * interrupts allowed to call FreeRTOS.
+ */
+#define LWIP_FREERTOS_SYS_ARCH_PROTECT_BASEPRI 1
+#define LWIP_FREERTOS_SYS_ARCH_PROTECT_PRIO    6
+/**
+ * LWIP_FREERTOS_SYS_ARCH_PROTECT_STATS==1: measure the time spent with the
+ * network interrupts masked, see sys_arch_protect_get_stats().
+ */
+#define LWIP_FREERTOS_SYS_ARCH_PROTECT_STATS   1
+
+/**
+ * LWIP_TCPIP_CORE_LOCKING==1: netconn and socket calls take the core lock and
+ * run in the calling thread instead of posting a message to the tcpip thread.
+ * The lock is a FreeRTOS mutex, so a low priority holder inherits the
+ * priority of the tasks waiting for it.
+ */
+#define LWIP_TCPIP_CORE_LOCKING         1
+
+/**
+ * LWIP_FREERTOS_CHECK_CORE_LOCKING==1: assert that core functions are only
+ * called with the core lock held (see sys_arch.c). Threads other than the
+ * tcpip thread must wrap raw API calls in LOCK_TCPIP_CORE()/UNLOCK_TCPIP_CORE().
+ */
+#ifndef LWIP_FREERTOS_CHECK_CORE_LOCKING
+#ifdef LWIP_NOASSERT
+#define LWIP_FREERTOS_CHECK_CORE_LOCKING 0
+#else
+#define LWIP_FREERTOS_CHECK_CORE_LOCKING 1
+#endif
+#endif
+
+#if LWIP_FREERTOS_CHECK_CORE_LOCKING
+void sys_check_core_locking(void);
+#define LWIP_ASSERT_CORE_LOCKED()       sys_check_core_locking()
+void sys_mark_tcpip_thread(void);
+#define LWIP_MARK_TCPIP_THREAD()        sys_mark_tcpip_thread()
+#if LWIP_TCPIP_CORE_LOCKING
+void sys_lock_tcpip_core(void);
+#define LOCK_TCPIP_CORE()               sys_lock_tcpip_core()
+void sys_unlock_tcpip_core(void);
+#define UNLOCK_TCPIP_CORE()             sys_unlock_tcpip_core()
+#endif /* LWIP_TCPIP_CORE_LOCKING */
+#endif /* LWIP_FREERTOS_CHECK_CORE_LOCKING */
+
 #endif /* __LWIPOPTS_H__ */
 
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
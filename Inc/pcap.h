@@ -0,0 +1,30 @@
+#ifndef PCAP_H
+#define PCAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lwip/err.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+
+/** Frames captured but not yet written by pcap_drain(), per direction.
+ * Must be a power of two. Every pending RX frame holds its RX pool buffer, so
+ * this bounds the buffers capture keeps from the pool. Every TX entry takes
+ * ETH_MAX_PACKET_SIZE bytes for the frame copy.
+ */
+#ifndef PCAP_RING_SIZE
+#define PCAP_RING_SIZE		4U
+#endif
+
+enum pcap_dir { PCAP_RX, PCAP_TX };
+
+typedef void (*pcap_write_fn)(const void *data, size_t len);
+
+void pcap_tap(enum pcap_dir dir, struct pbuf *p);
+size_t pcap_drain(pcap_write_fn write);
+uint32_t pcap_dropped(void);
+uint32_t pcap_truncated(void);
+err_t pcap_replay(struct netif *netif, const void *file, size_t len, int realtime);
+
+#endif /* PCAP_H */
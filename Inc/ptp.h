@@ -0,0 +1,54 @@
+#ifndef PTP_H
+#define PTP_H
+
+#include <stdint.h>
+
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+
+#include "ethptp.h"
+
+/** PTP domain the slave listens to */
+#ifndef PTP_DOMAIN
+#define PTP_DOMAIN			0U
+#endif
+
+/** Interval between Delay_Req messages to the master */
+#ifndef PTP_DELAY_REQ_INTERVAL_MS
+#define PTP_DELAY_REQ_INTERVAL_MS	1000U
+#endif
+
+/** Offsets from the master larger than this step the clock instead of
+ * slewing it with the servo */
+#ifndef PTP_STEP_THRESHOLD_NS
+#define PTP_STEP_THRESHOLD_NS		100000
+#endif
+
+/** PI servo gains in tenths of ppb per ns of offset, tuned for one Sync per
+ * second */
+#ifndef PTP_SERVO_KP
+#define PTP_SERVO_KP			7
+#endif
+#ifndef PTP_SERVO_KI
+#define PTP_SERVO_KI			3
+#endif
+
+#define PTP_EVENT_PORT			319U
+#define PTP_GENERAL_PORT		320U
+
+struct ptp_stats {
+	uint32_t syncs;			/* Sync messages with their origin timestamp */
+	uint32_t delay_resps;		/* Delay_Resp messages matching our Delay_Req */
+	uint32_t steps;			/* clock steps by more than PTP_STEP_THRESHOLD_NS */
+	uint32_t errors;		/* clock adjustments the MAC did not accept in time */
+	int32_t offset_ns;		/* last offset from the master, positive if ahead */
+	int32_t path_delay_ns;		/* mean path delay to the master */
+	int32_t freq_ppb;		/* current frequency adjustment of the clock */
+	uint8_t master[10];		/* port identity of the master followed */
+};
+
+void ptp_init(struct netif *netif);
+void ptp_get_stats(struct ptp_stats *stats);
+void ptp_tx_timestamp(const struct pbuf *p, uint16_t offset, const struct ethptp_time *ts);
+
+#endif /* PTP_H */
@@ -0,0 +1,47 @@
+#ifndef RTSTATS_H
+#define RTSTATS_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+/** Maximum number of tasks in a snapshot. Must not be lower than the number
+ * of tasks, the snapshot is empty otherwise.
+ */
+#ifndef RTSTATS_MAX_TASKS
+#define RTSTATS_MAX_TASKS	12U
+#endif
+
+/** Set this to a UDP port to answer any datagram received on it with the
+ * latest struct rtstats. 0 disables the UDP export.
+ */
+#ifndef RTSTATS_UDP_PORT
+#define RTSTATS_UDP_PORT	0U
+#endif
+
+struct rtstats_task {
+	char name[configMAX_TASK_NAME_LEN];
+	uint32_t number;	/* xTaskNumber, stable for the task lifetime */
+	uint64_t runtime;	/* run-time counter since the task was created */
+	uint16_t load;		/* CPU load over the last interval, in 0.01 % */
+	uint16_t stack_free;	/* stack high water mark, in words */
+	uint8_t prio;		/* current priority */
+	uint8_t state;		/* eTaskState */
+};
+
+struct rtstats {
+	uint32_t seq;		/* incremented on every rtstats_update() */
+	uint64_t interval;	/* run-time counter ticks since the previous update */
+	uint32_t count;		/* valid entries in task[] */
+	struct rtstats_task task[RTSTATS_MAX_TASKS];
+};
+
+/* Latest complete snapshot, for the debugger */
+extern const struct rtstats *volatile g_rtstats;
+
+void rtstats_update(void);
+#if RTSTATS_UDP_PORT
+void rtstats_udp_init(void);
+#endif
+
+#endif /* RTSTATS_H */
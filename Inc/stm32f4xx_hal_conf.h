@@ -46,6 +46,9 @@
 /* #define HAL_DCMI_MODULE_ENABLED */
 /* #define HAL_DMA2D_MODULE_ENABLED */
 #define HAL_ETH_MODULE_ENABLED
+#if defined(ETHIF_PTP) && ETHIF_PTP
+#define HAL_ETH_USE_PTP
+#endif
 /* #define HAL_ETH_LEGACY_MODULE_ENABLED */
 /* #define HAL_NAND_MODULE_ENABLED */
 /* #define HAL_NOR_MODULE_ENABLED */
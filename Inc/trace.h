@@ -0,0 +1,77 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#include "stm32f4xx_hal.h"
+
+/** Set this to 0 to compile out all TRACE() probes */
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE		1
+#endif
+
+/** Number of records in the trace ring, must be a power of two */
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE		256U
+#endif
+
+#define TRACE_MAGIC		0x45435254UL	/* "TRCE" in memory */
+
+enum trace_id {
+	TRACE_RX_ALLOC = 1,	/* RX buffer handed to the DMA, arg: pbuf */
+	TRACE_RX_LINK,		/* RX buffer filled by the DMA, arg: pbuf */
+	TRACE_RX_INPUT,		/* frame leaves low_level_input(), arg: pbuf */
+	TRACE_RX_FREE,		/* RX or small RX buffer back in its pool, arg: pbuf */
+	TRACE_TX_ENTER,		/* low_level_output() entry, arg: frame length */
+	TRACE_TX_EXIT,		/* low_level_output() exit, arg: err_t */
+	TRACE_MBOX_POST,	/* sys_mbox_post()/trypost(), arg: msg */
+	TRACE_MBOX_FETCH,	/* message fetched from an mbox, arg: msg */
+	TRACE_RX_COPY,		/* short frame copied to a small buffer, arg: pbuf copied from */
+};
+
+/* ts is DWT->CYCCNT. ev holds the trace_id in bits 31..24 and the low 24 bits
+ * of the argument, which is enough to tell SRAM addresses apart. */
+struct trace_rec {
+	uint32_t ts;
+	uint32_t ev;
+};
+
+/* Dumped by the debugger and decoded with tools/trace_decode.py */
+struct trace_buf {
+	uint32_t magic;		/* TRACE_MAGIC once trace_init() ran */
+	uint32_t size;		/* TRACE_RING_SIZE */
+	uint32_t hz;		/* timestamp clock */
+	uint32_t head;		/* records written, rec[head % size] is the next one */
+	struct trace_rec rec[TRACE_RING_SIZE];
+};
+
+#if TRACE_ENABLE
+
+#if (TRACE_RING_SIZE & (TRACE_RING_SIZE - 1U)) != 0U
+#error "TRACE_RING_SIZE must be a power of two"
+#endif
+
+extern struct trace_buf g_trace;
+
+void trace_init(void);
+
+/* A slot is claimed with one LDREX/STREX increment, so probes may run in
+ * tasks and interrupts alike without a critical section. */
+static inline void trace(enum trace_id id, uint32_t arg)
+{
+	uint32_t i = __atomic_fetch_add(&g_trace.head, 1U, __ATOMIC_RELAXED) & (TRACE_RING_SIZE - 1U);
+
+	g_trace.rec[i].ts = DWT->CYCCNT;
+	g_trace.rec[i].ev = ((uint32_t)id << 24) | (arg & 0xFFFFFFUL);
+}
+
+#define TRACE(id, arg)		trace((id), (uint32_t)(uintptr_t)(arg))
+
+#else
+
+#define trace_init()
+#define TRACE(id, arg)
+
+#endif /* TRACE_ENABLE */
+
+#endif /* TRACE_H */
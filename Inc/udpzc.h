@@ -0,0 +1,51 @@
+#ifndef UDPZC_H
+#define UDPZC_H
+
+#include "lwip/api.h"
+#include "lwip/pbuf.h"
+
+/* Zero-copy UDP on top of a netconn of type NETCONN_UDP.
+ *
+ * Received datagrams are the RX pbufs of the driver, without the copy into
+ * a user buffer done by the socket API. A large frame holds a zero-copy RX
+ * buffer until it is released, so hold on to them only briefly, or the DMA
+ * runs out of buffers. Frames up to ETH_RX_SMALL_BUFFER_SIZE are already in
+ * a small buffer of their own.
+ *
+ * Sent datagrams reference the caller's buffer. The completion callback runs
+ * once the stack holds no more reference to it. That is where the TX
+ * descriptor of the frame is released, usually the tcpip thread, or the
+ * sending task if the datagram was copied (e.g. queued for ARP) or could not
+ * be sent. It is called exactly once per udpzc_sendto() and must not block.
+ *
+ * The ETH DMA reads sent data in place, so it must be in SRAM at 0x20000000.
+ * The DMA can't reach the CCM RAM at 0x10000000, which holds the task
+ * stacks, so data must not be a local buffer of the sending task.
+ */
+
+struct udpzc_rx {
+	struct netbuf *buf;
+	const void *data;	/* first pbuf of the datagram */
+	u16_t len;		/* bytes at data */
+	u16_t tot_len;		/* whole datagram, more than len if it is chained */
+	ip_addr_t addr;
+	u16_t port;
+};
+
+struct udpzc_tx;
+typedef void (*udpzc_done_fn)(struct udpzc_tx *tx, void *arg);
+
+/* Owned by the caller, must stay valid until done is called */
+struct udpzc_tx {
+	struct pbuf_custom pc;
+	udpzc_done_fn done;
+	void *arg;
+};
+
+err_t udpzc_recv(struct netconn *conn, struct udpzc_rx *rx);
+void udpzc_release(struct udpzc_rx *rx);
+
+err_t udpzc_sendto(struct netconn *conn, struct udpzc_tx *tx, const void *data, u16_t len,
+		   const ip_addr_t *addr, u16_t port, udpzc_done_fn done, void *arg);
+
+#endif /* UDPZC_H */
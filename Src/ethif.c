@@ -1,25 +1,173 @@
+#include <string.h>
+
 #include "lwip/init.h"
 #include "lwip/timeouts.h"
 #include "lwip/etharp.h"
 #include "lwip/memp.h"
 #include "lwip/pbuf.h"
+#include "lwip/prot/ip.h"
+#include "lwip/prot/ip4.h"
+#include "lwip/prot/udp.h"
 #include "lwip/snmp.h"
+#include "lwip/sys.h"
+#include "lwip/tcpip.h"
 #include "netif/ethernet.h"
 
 #include "stm32f4xx_hal.h"
 
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+
 #include "hw_delay.h"
 #include "ethif.h"
-
+#include "pcap.h"
+#include "ethptp.h"
+#include "ptp.h"
+#include "trace.h"
+
+
+/** Set this to 1 to poll the RX descriptors every ETHIF_RX_POLL_PERIOD_MS
+ * instead of waiting for the ETH DMA receive interrupt.
+ */
+#ifndef ETHIF_RX_POLLING
+#define ETHIF_RX_POLLING			0
+#endif
+
+/** Set this to 1 to hand frames to the DMA with HAL_ETH_Transmit_IT() and
+ * return immediately. Transmitted pbufs are held and freed once the DMA
+ * releases their descriptors. Frames sent while all ETH_TX_DESC_CNT
+ * descriptors are in flight are dropped with ERR_MEM.
+ * Set this to 0 to block in HAL_ETH_Transmit() until each frame is sent.
+ */
+#ifndef ETHIF_TX_QUEUED
+#define ETHIF_TX_QUEUED				1
+#endif
+
+#if ETHIF_RX_BATCH < 1
+#error "ETHIF_RX_BATCH must be at least 1"
+#endif
+
+#if ETHIF_TX_QUEUED && ETHIF_RX_POLLING
+#error "ETHIF_TX_QUEUED requires ETH interrupts, disable ETHIF_RX_POLLING"
+#endif
+
+#if ETHIF_PTP && !ETHIF_TX_QUEUED
+#error "ETHIF_PTP reports TX timestamps from HAL_ETH_ReleaseTxPacket(), enable ETHIF_TX_QUEUED"
+#endif
+
+#if ETHIF_PTP && !defined(HAL_ETH_USE_PTP)
+#error "ETHIF_PTP requires HAL_ETH_USE_PTP, define ETHIF_PTP on the compiler command line"
+#endif
+
+/** Set this to 1 to poll the PHY link status every ETHIF_PHY_POLL_PERIOD_MS
+ * instead of waiting for the PHY interrupt pin. PHYs without an interrupt
+ * source are always polled.
+ */
+#ifndef ETHIF_PHY_POLLING
+#define ETHIF_PHY_POLLING			0
+#endif
+
+/* Delay between a PHY interrupt and the link status readout,
+ * so a flapping link is reported once */
+#ifndef ETHIF_PHY_DEBOUNCE_MS
+#define ETHIF_PHY_DEBOUNCE_MS			0U
+#endif
+
+/** Number of multicast MAC addresses filtered in hardware. Three of them
+ * use the perfect filter, the others the 64-bin hash table. All multicast
+ * is accepted while more addresses are joined.
+ */
+#ifndef ETHIF_MCAST_CNT
+#define ETHIF_MCAST_CNT				16U
+#endif
+
+/* MACA1 to MACA3, MACA0 holds the station address */
+#define ETH_MAC_PERFECT_CNT			3U
+
+#define ETHIF_PHY_POLL_PERIOD_MS		100U
+/* Upper bound for the link task sleep in interrupt mode */
+#define ETHIF_PHY_WAIT_TIMEOUT_MS		1000U
+
+#define ETHIF_RX_POLL_PERIOD_MS			2U
+/* Upper bound for the input task sleep in interrupt mode, so a missed
+ * notification only delays reception instead of stalling it */
+#define ETHIF_RX_WAIT_TIMEOUT_MS		100U
+/* Must be numerically not lower than configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY */
+#define ETH_IRQ_PRIORITY			6U
 
 #define ETH_DMA_TRANSMIT_TIMEOUT		20U
 
+/* Number of zero-copy RX buffers */
+#ifndef ETH_RX_BUFFER_CNT
+#define ETH_RX_BUFFER_CNT			12U
+#endif
+
+/* Size of a zero-copy RX buffer, frames that don't fit are received into
+ * a chain of buffers. The ETH DMA requires a multiple of 4. */
+#ifndef ETH_RX_BUFFER_SIZE
+#define ETH_RX_BUFFER_SIZE			ETH_RX_BUF_SIZE
+#endif
+
+#if (ETH_RX_BUFFER_SIZE % 4) != 0
+#error "ETH_RX_BUFFER_SIZE must be a multiple of 4"
+#endif
+
+/* RX buffers a full size TCP segment is received into */
+#define ETH_RX_SEGMENT_BUFFERS			((TCP_MSS + PBUF_LINK_HLEN + PBUF_IP_HLEN + PBUF_TRANSPORT_HLEN \
+						  + ETH_RX_BUFFER_SIZE - 1U) / ETH_RX_BUFFER_SIZE)
+
+/* Received segments stay in their RX buffers until the application reads
+ * them, so a full window must fit into the buffers not in the DMA ring */
+#if LWIP_TCP && ((((TCP_WND + TCP_MSS - 1U) / TCP_MSS) * ETH_RX_SEGMENT_BUFFERS) > (ETH_RX_BUFFER_CNT - ETH_RX_DESC_CNT))
+#error "TCP_WND does not fit into the RX pool, raise ETH_RX_BUFFER_CNT"
+#endif
+
+#if ETHIF_PCAP && (PCAP_RING_SIZE >= ETH_RX_BUFFER_CNT)
+#error "PCAP_RING_SIZE must leave RX buffers for reception"
+#endif
+
+/* Linker section of the RX pool. The ETH DMA has no access to CCMRAM,
+ * so the linker script must place the section in the RAM region. */
+#ifndef ETH_RX_POOL_SECTION
+#define ETH_RX_POOL_SECTION			".eth_rx_pool"
+#endif
+
+/* Frames up to this size are copied out of the zero-copy RX buffer into a
+ * small buffer, so the large buffer is returned to the DMA right away.
+ * Set to 0 to keep all frames zero-copy. */
+#ifndef ETH_RX_SMALL_BUFFER_SIZE
+#define ETH_RX_SMALL_BUFFER_SIZE		128U
+#endif
+
+#ifndef ETH_RX_SMALL_BUFFER_CNT
+#define ETH_RX_SMALL_BUFFER_CNT			16U
+#endif
+
+#if ETH_RX_SMALL_BUFFER_SIZE > ETH_RX_BUFFER_SIZE
+#error "ETH_RX_SMALL_BUFFER_SIZE must not exceed ETH_RX_BUFFER_SIZE"
+#endif
+
 typedef struct
 {
 	struct pbuf_custom pbuf_custom;
-	uint8_t buff[(ETH_RX_BUF_SIZE + 31) & ~31] __ALIGNED(32);
+#if ETHIF_PTP
+	struct ethptp_time ts;
+#endif
+	uint8_t buff[(ETH_RX_BUFFER_SIZE + 31) & ~31] __ALIGNED(32);
 } RxBuff_t;
 
+#if ETH_RX_SMALL_BUFFER_SIZE
+typedef struct
+{
+	struct pbuf_custom pbuf_custom;
+#if ETHIF_PTP
+	struct ethptp_time ts;
+#endif
+	uint8_t buff[ETH_RX_SMALL_BUFFER_SIZE] __ALIGNED(4);
+} RxSmallBuff_t;
+#endif
+
 typedef enum
 {
 	RX_ALLOC_OK		= 0x00,
@@ -27,18 +175,55 @@ typedef enum
 } RxAllocStatusTypeDef;
 
 /* Memory Pool Declaration */
-#define ETH_RX_BUFFER_CNT		12U
+extern u8_t memp_memory_RX_POOL_base[] __attribute__((section(ETH_RX_POOL_SECTION)));
 LWIP_MEMPOOL_DECLARE(RX_POOL, ETH_RX_BUFFER_CNT, sizeof(RxBuff_t), "Zero-copy RX PBUF pool")
+#if ETH_RX_SMALL_BUFFER_SIZE
+LWIP_MEMPOOL_DECLARE(RX_SMALL_POOL, ETH_RX_SMALL_BUFFER_CNT, sizeof(RxSmallBuff_t), "Small frame RX PBUF pool")
+#endif
 
 static uint8_t RxAllocStatus;
+static struct ethif_rx_pool_stats s_rx_pool_stats;
 static ETH_HandleTypeDef s_heth;
 static ETH_TxPacketConfig TxConfig;
+static TaskHandle_t s_rx_task;
+static TaskHandle_t s_link_task;
+static const struct ethphy_drv *s_phy = &ethphy_generic;
+/* The MAC mode could not follow the PHY, the link is not reported up yet */
+static int s_mac_mode_pending;
+#if ETHIF_TX_QUEUED
+/* Posted by the TX complete interrupt, so sent frames are released even if
+ * no further frame is transmitted */
+static struct tcpip_callback_msg *s_tx_reclaim_msg;
+static u32_t s_tx_reclaim_pending;
+/* Frames in the TX ring not released yet. Every one of them holds a pbuf
+ * reference, and lwIP does not retransmit a TCP segment whose pbuf is still
+ * referenced, so none may wait for the next transmission. Only written by the
+ * tcpip thread. */
+static u32_t s_tx_frames;
+#endif
+
+/* Frames drained from the DMA in one pass, posted to the tcpip thread as one
+ * message. There are two, so the input task fills one while the tcpip thread
+ * processes the other. s_rx_batch_sem counts the batches not in flight. */
+struct rx_batch {
+	struct tcpip_callback_msg *msg;
+	struct netif *netif;
+	u32_t cnt;
+	struct pbuf *p[ETHIF_RX_BATCH];
+};
+
+static struct rx_batch s_rx_batch[2];
+static u32_t s_rx_batch_idx;
+static SemaphoreHandle_t s_rx_batch_sem;
 
 
 #define RMII_PHY_RST_PORT			GPIOD
 #define RMII_PHY_RST_PIN			GPIO_PIN_10
 #define RMII_CSR_DV_PORT			GPIOA
 #define RMII_CSR_DV_PIN				GPIO_PIN_7
+#define RMII_PHY_INT_PORT			GPIOE
+#define RMII_PHY_INT_PIN			GPIO_PIN_8
+#define RMII_PHY_INT_IRQn			EXTI9_5_IRQn
 #define KSZ8081_RESET_ASSERT_DELAY_US		500
 #define KSZ8081_BOOTUP_DELAY_US			100
 
@@ -77,36 +262,6 @@ static void ksz8081_bootstrap(void)
 }
 
 
-/* PHY registers */
-#define PHY_BASIC_CONTROL			((uint16_t)0x0000)
-#define PHY_BASIC_STATUS			((uint16_t)0x0001)
-#define PHY_IDENTIFIER1				((uint16_t)0x0002)
-#define PHY_IDENTIFIER2				((uint16_t)0x0003)
-#define PHY_AUTONEG_ADVERTISEMENT		((uint16_t)0x0004)
-#define PHY_AUTONEG_LINK_PARTNER_ABILITY	((uint16_t)0x0005)
-#define PHY_AUTONEG_EXPANSION			((uint16_t)0x0006)
-#define PHY_AUTONEG_NEXT_PAGE			((uint16_t)0x0007)
-#define PHY_LINK_PARTNER_NEXT_PAGE_ABILITY	((uint16_t)0x0008)
-#define PHY_DIGITAL_RESERVED_CONTROL		((uint16_t)0x0010)
-#define PHY_AFE_CONTROL1			((uint16_t)0x0011)
-#define PHY_RX_ERROR_COUNTER			((uint16_t)0x0015)
-#define PHY_OPERATION_MODE_STRAP_OVERRIDE	((uint16_t)0x0016)
-#define PHY_OPERATION_MODE_STRAP_STATUS		((uint16_t)0x0017)
-#define PHY_EXPANDED_CONTROL			((uint16_t)0x0018)
-#define PHY_INTERRUPT_CONTROL			((uint16_t)0x001B)
-#define PHY_INTERRUPT_STATUS			((uint16_t)0x001B)
-#define PHY_LINKMD_CONTROL			((uint16_t)0x001D)
-#define PHY_LINKMD_STATUS			((uint16_t)0x001D)
-#define PHY_CONTROL1				((uint16_t)0x001E)
-#define PHY_CONTROL2				((uint16_t)0x001F)
-
-/* PHY masks */
-#define PHY_REF_CLOCK_SELECT_MASK		((uint16_t)0x0080)
-#define PHY_REF_CLOCK_SELECT_25MHZ		((uint16_t)0x0080)
-#define PHY_LINK_INT_UP_OCCURRED		((uint16_t)0x0001)
-#define PHY_LINK_INT_DOWN_OCCURED		((uint16_t)0x0004)
-
-
 void HAL_ETH_MspInit(ETH_HandleTypeDef *heth)
 {
 	ksz8081_bootstrap();
@@ -157,7 +312,7 @@ void HAL_ETH_MspInit(ETH_HandleTypeDef *heth)
 	HAL_ETH_SetMDIOClockRange(heth);
 
 	uint32_t phyreg = 0U;
-	HAL_StatusTypeDef status = HAL_ETH_ReadPHYRegister(heth, 0, PHY_CONTROL2, &phyreg);
+	HAL_StatusTypeDef status = HAL_ETH_ReadPHYRegister(heth, ETH_PHY_ADDR, PHY_CONTROL2, &phyreg);
 	if (status != HAL_OK) {
 		return;
 	}
@@ -169,12 +324,58 @@ void HAL_ETH_MspInit(ETH_HandleTypeDef *heth)
 	 * of MAC subsystem will never cleared */
 	phyreg &= (uint16_t)(~(PHY_REF_CLOCK_SELECT_MASK));
 	phyreg |= (PHY_REF_CLOCK_SELECT_25MHZ);
-	status = HAL_ETH_WritePHYRegister(heth, 0, PHY_CONTROL2, phyreg);
+	status = HAL_ETH_WritePHYRegister(heth, ETH_PHY_ADDR, PHY_CONTROL2, phyreg);
 	if (status != HAL_OK) {
 		return;
 	}
 }
 
+/* Each pbuf in the chain should have its tot_len set to its own length,
+ * plus the length of all the following pbufs in the chain. */
+static void rx_chain_fixup(struct pbuf *p)
+{
+	uint16_t tot_len = p->tot_len;
+
+	for ( ; p != NULL; p = p->next) {
+		p->tot_len = tot_len;
+		tot_len = (uint16_t)(tot_len - p->len);
+	}
+}
+
+#if ETH_RX_SMALL_BUFFER_SIZE
+static void pbuf_free_small(struct pbuf *p)
+{
+	struct pbuf_custom* custom_pbuf = (struct pbuf_custom*)p;
+	TRACE(TRACE_RX_FREE, p);
+	LWIP_MEMPOOL_FREE(RX_SMALL_POOL, custom_pbuf);
+}
+
+/* Moves a short frame out of its zero-copy buffer, so ACKs and ARP don't pin
+ * a full size DMA buffer while lwIP holds them. The zero-copy buffer is kept
+ * if the small pool is empty. */
+static struct pbuf *rx_small_copy(struct pbuf *p)
+{
+	struct pbuf_custom *small = LWIP_MEMPOOL_ALLOC(RX_SMALL_POOL);
+	if (small == NULL) {
+		return p;
+	}
+
+	uint8_t *buff = (uint8_t *)small + offsetof(RxSmallBuff_t, buff);
+	small->custom_free_function = pbuf_free_small;
+	struct pbuf *q = pbuf_alloced_custom(PBUF_RAW, p->tot_len, PBUF_REF, small, buff, ETH_RX_SMALL_BUFFER_SIZE);
+	memcpy(buff, p->payload, p->len);
+#if ETHIF_PTP
+	((RxSmallBuff_t *)small)->ts = ((RxBuff_t *)p)->ts;
+#endif
+
+	/* Return the zero-copy buffer to the pool for the next descriptor rebuild */
+	TRACE(TRACE_RX_COPY, p);
+	pbuf_free(p);
+
+	return q;
+}
+#endif /* ETH_RX_SMALL_BUFFER_SIZE */
+
 struct pbuf *low_level_input(struct netif *netif)
 {
 	(void)netif;
@@ -184,57 +385,406 @@ struct pbuf *low_level_input(struct netif *netif)
 	if (RxAllocStatus == RX_ALLOC_OK) {
 		if (HAL_ETH_ReadData(&s_heth, (void **)&p) != HAL_OK) {
 			p = NULL;
+		} else if ((p != NULL) && (p->next != NULL)) {
+			rx_chain_fixup(p);
 		}
 	}
+	if (p != NULL) {
+#if ETHIF_PTP
+		/* Snapshot of the last descriptor of the frame, taken by HAL_ETH_ReadData() */
+		ETH_TimeStampTypeDef ts = { 0 };
+		(void)HAL_ETH_PTP_GetRxTimestamp(&s_heth, &ts);
+		((RxBuff_t *)p)->ts.sec = ts.TimeStampHigh;
+		((RxBuff_t *)p)->ts.nsec = ts.TimeStampLow;
+#endif
+	}
+
+#if ETH_RX_SMALL_BUFFER_SIZE
+	if ((p != NULL) && (p->tot_len <= ETH_RX_SMALL_BUFFER_SIZE)) {
+		p = rx_small_copy(p);
+	}
+#endif
+
+	if (p != NULL) {
+		/* The pbuf handed to the stack, after a possible copy */
+		TRACE(TRACE_RX_INPUT, p);
+#if ETHIF_PCAP
+		pcap_tap(PCAP_RX, p);
+#endif
+	}
 
 	return p;
 }
 
+#if ETHIF_PTP
+/* Offset of the PTP message in a PTP event frame over UDP/IPv4, or 0 if p is
+ * another frame. The headers are in the first pbuf of all frames sent by lwIP. */
+static u16_t ptp_event_offset(const struct pbuf *p)
+{
+	const u8_t *f = (const u8_t *)p->payload;
+
+	if ((p->len < SIZEOF_ETH_HDR + IP_HLEN + UDP_HLEN) ||
+	    (f[12] != 0x08U) || (f[13] != 0x00U) || (f[SIZEOF_ETH_HDR + 9U] != IP_PROTO_UDP)) {
+		return 0U;
+	}
+
+	u16_t udp = (u16_t)(SIZEOF_ETH_HDR + (f[SIZEOF_ETH_HDR] & 0x0FU) * 4U);
+	if ((p->len < udp + UDP_HLEN) || ((((u16_t)f[udp + 2U] << 8) | f[udp + 3U]) != PTP_EVENT_PORT)) {
+		return 0U;
+	}
+	return (u16_t)(udp + UDP_HLEN);
+}
+
+/* Requests a TX timestamp if the next frame is a PTP event message */
+static void tx_timestamp_request(const struct pbuf *p)
+{
+	if (ptp_event_offset(p) != 0U) {
+		HAL_StatusTypeDef status = HAL_ETH_PTP_InsertTxTimestamp(&s_heth);
+		LWIP_ASSERT("PTP not configured", status == HAL_OK);
+		(void)status;
+	}
+}
+#endif /* ETHIF_PTP */
+
+/* Buffer list of the frame being sent. HAL_ETH_Transmit(_IT)() copies it into
+ * the DMA descriptors before returning, and low_level_output() is serialized
+ * by the tcpip core, so the list is only owned for the duration of one call. */
+static ETH_BufferTypeDef s_tx_buffers[ETH_TX_DESC_CNT];
+
+/* Frames with more pbufs than TX descriptors are copied into this buffer.
+ * It is busy until the DMA has sent the frame, only touched by the tcpip
+ * thread. */
+static struct pbuf_custom s_tx_bounce;
+static uint8_t s_tx_bounce_buff[ETH_TX_BUF_SIZE] __ALIGNED(4);
+static uint8_t s_tx_bounce_busy;
+
+static void pbuf_free_bounce(struct pbuf *p)
+{
+	(void)p;
+	s_tx_bounce_busy = 0U;
+}
+
 static err_t low_level_output(struct netif *netif, struct pbuf *p)
 {
 	(void)netif;
 	uint32_t i = 0U;
 	struct pbuf *q = NULL;
 	err_t errval = ERR_OK;
-	ETH_BufferTypeDef Txbuffer[ETH_TX_DESC_CNT] = { 0 };
 
-	for (q = p; q != NULL; q = q->next) {
-		if (i >= ETH_TX_DESC_CNT) {
-			return ERR_IF;
-		}
+	TRACE(TRACE_TX_ENTER, p->tot_len);
 
-		Txbuffer[i].buffer = q->payload;
-		Txbuffer[i].len = q->len;
+#if ETHIF_PCAP
+	pcap_tap(PCAP_TX, p);
+#endif
 
-		if (i > 0) {
-			Txbuffer[i-1].next = &Txbuffer[i];
-		}
+	for (q = p; (q != NULL) && (i < ETH_TX_DESC_CNT); q = q->next) {
+		s_tx_buffers[i].buffer = q->payload;
+		s_tx_buffers[i].len = q->len;
+		s_tx_buffers[i].next = &s_tx_buffers[i + 1U];
+		i++;
+	}
 
-		if (q->next == NULL) {
-			Txbuffer[i].next = NULL;
+	if (q != NULL) {
+		/* The chain is longer than the TX ring, coalesce it into the
+		 * bounce buffer */
+		if (p->tot_len > sizeof(s_tx_bounce_buff)) {
+			TRACE(TRACE_TX_EXIT, ERR_IF);
+			return ERR_IF;
 		}
-
-		i++;
+		if (s_tx_bounce_busy) {
+			TRACE(TRACE_TX_EXIT, ERR_MEM);
+			return ERR_MEM;
+		}
+		s_tx_bounce_busy = 1U;
+		s_tx_bounce.custom_free_function = pbuf_free_bounce;
+		q = pbuf_alloced_custom(PBUF_RAW, p->tot_len, PBUF_REF, &s_tx_bounce,
+				s_tx_bounce_buff, sizeof(s_tx_bounce_buff));
+		(void)pbuf_copy_partial(p, s_tx_bounce_buff, p->tot_len, 0U);
+		p = q;
+
+		s_tx_buffers[0].buffer = p->payload;
+		s_tx_buffers[0].len = p->len;
+		i = 1U;
+	} else {
+		/* Hold the pbuf until it has been sent */
+		pbuf_ref(p);
 	}
+	s_tx_buffers[i - 1U].next = NULL;
 
 	TxConfig.Length = p->tot_len;
-	TxConfig.TxBuffer = Txbuffer;
+	TxConfig.TxBuffer = s_tx_buffers;
 	TxConfig.pData = p;
 
+#if ETHIF_TX_QUEUED
+	/* Reclaim descriptors of the frames sent since the previous call */
+	HAL_ETH_ReleaseTxPacket(&s_heth);
+#if ETHIF_PTP
+	tx_timestamp_request(p);
+#endif
+	__atomic_store_n(&s_tx_frames, s_tx_frames + 1U, __ATOMIC_RELAXED);
+	if (HAL_ETH_Transmit_IT(&s_heth, &TxConfig) != HAL_OK) {
+		/* TX ring is full. Drop the frame instead of waiting for the DMA
+		 * with the tcpip core locked, TCP retransmits it and UDP senders
+		 * get ERR_MEM. */
+		__atomic_store_n(&s_tx_frames, s_tx_frames - 1U, __ATOMIC_RELAXED);
+		pbuf_free(p);
+		errval = ERR_MEM;
+	}
+#else
 	HAL_StatusTypeDef err_hal = HAL_ETH_Transmit(&s_heth, &TxConfig, ETH_DMA_TRANSMIT_TIMEOUT);
 	if (err_hal != HAL_OK) {
 		errval = ERR_IF;
 	}
+	pbuf_free(p);
+#endif /* ETHIF_TX_QUEUED */
 
+	TRACE(TRACE_TX_EXIT, errval);
 	return errval;
 }
 
+#if ETHIF_TX_QUEUED
+/* Runs in the tcpip thread, serialized with low_level_output() */
+static void tx_reclaim(void *ctx)
+{
+	(void)ctx;
+
+	__atomic_store_n(&s_tx_reclaim_pending, 0U, __ATOMIC_RELAXED);
+	HAL_ETH_ReleaseTxPacket(&s_heth);
+}
+
+void HAL_ETH_TxCpltCallback(ETH_HandleTypeDef *heth)
+{
+	(void)heth;
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	/* One pending message covers all frames completed until it runs, none
+	 * is needed once the ring is empty */
+	if ((__atomic_load_n(&s_tx_frames, __ATOMIC_RELAXED) != 0U) &&
+	    (__atomic_exchange_n(&s_tx_reclaim_pending, 1U, __ATOMIC_RELAXED) == 0U)) {
+		err_t err = tcpip_callbackmsg_trycallback_fromisr(s_tx_reclaim_msg);
+		if (err == ERR_NEED_SCHED) {
+			xHigherPriorityTaskWoken = pdTRUE;
+		} else if (err != ERR_OK) {
+			/* tcpip mbox full, retry on the next completed frame */
+			__atomic_store_n(&s_tx_reclaim_pending, 0U, __ATOMIC_RELAXED);
+		}
+	}
+	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+void HAL_ETH_TxFreeCallback(uint32_t *buff)
+{
+	/* Called by HAL_ETH_ReleaseTxPacket() with the TxConfig.pData of a sent frame */
+	__atomic_store_n(&s_tx_frames, s_tx_frames - 1U, __ATOMIC_RELAXED);
+	pbuf_free((struct pbuf *)buff);
+}
+
+#if ETHIF_PTP
+/* Called by HAL_ETH_ReleaseTxPacket() before HAL_ETH_TxFreeCallback() for
+ * frames sent with a timestamp */
+void HAL_ETH_TxPtpCallback(uint32_t *buff, ETH_TimeStampTypeDef *timestamp)
+{
+	const struct pbuf *p = (const struct pbuf *)buff;
+	u16_t offset = ptp_event_offset(p);
+
+	if (offset != 0U) {
+		struct ethptp_time ts = {
+			.sec = timestamp->TimeStampHigh,
+			.nsec = timestamp->TimeStampLow,
+		};
+		ptp_tx_timestamp(p, offset, &ts);
+	}
+}
+#endif /* ETHIF_PTP */
+#endif /* ETHIF_TX_QUEUED */
+
+/* Runs in the tcpip thread */
+static void rx_batch_input(void *ctx)
+{
+	struct rx_batch *batch = ctx;
+
+	for (u32_t i = 0U; i < batch->cnt; i++) {
+		if (ethernet_input(batch->p[i], batch->netif) != ERR_OK) {
+			pbuf_free(batch->p[i]);
+		}
+	}
+	batch->cnt = 0U;
+
+	(void)xSemaphoreGive(s_rx_batch_sem);
+}
+
+#if LWIP_IGMP || LWIP_IPV6_MLD
+struct mcast_addr {
+	u8_t addr[ETHARP_HWADDR_LEN];
+	u16_t refcnt;		/* groups mapped to addr, 0 if the entry is free */
+};
+
+/* Only changed by the MAC filter callbacks, serialized by the tcpip core */
+static struct mcast_addr s_mcast[ETHIF_MCAST_CNT];
+/* Joins that found no free entry */
+static u32_t s_mcast_overflow;
+
+/* Consecutive writes to a MAC register need a delay in between (ES0182 2.17.5) */
+static void mac_reg_write(volatile uint32_t *reg, uint32_t val)
+{
+	*reg = val;
+	(void)*reg;
+	delay_us(1);
+}
+
+/* Hash table bin of a MAC address: the upper 6 bits of its bit reversed
+ * Ethernet CRC */
+static uint32_t mcast_hash(const u8_t *addr)
+{
+	uint32_t crc = 0xFFFFFFFFUL;
+
+	for (uint32_t i = 0U; i < ETHARP_HWADDR_LEN; i++) {
+		crc ^= addr[i];
+		for (uint32_t bit = 0U; bit < 8U; bit++) {
+			crc = (crc >> 1) ^ (((crc & 1U) != 0U) ? 0xEDB88320UL : 0UL);
+		}
+	}
+
+	return __RBIT(~crc) >> 26;
+}
+
+/* Programs the perfect filter and the hash table from s_mcast */
+static void mcast_apply(void)
+{
+	volatile uint32_t *const perfect[ETH_MAC_PERFECT_CNT][2] = {
+		{ &ETH->MACA1HR, &ETH->MACA1LR },
+		{ &ETH->MACA2HR, &ETH->MACA2LR },
+		{ &ETH->MACA3HR, &ETH->MACA3LR },
+	};
+	uint32_t hash[2] = { 0U, 0U };
+	uint32_t n = 0U;
+
+	for (uint32_t i = 0U; i < ETHIF_MCAST_CNT; i++) {
+		const u8_t *addr = s_mcast[i].addr;
+
+		if (s_mcast[i].refcnt == 0U) {
+			continue;
+		}
+		if (n < ETH_MAC_PERFECT_CNT) {
+			mac_reg_write(perfect[n][1], ((uint32_t)addr[3] << 24) | ((uint32_t)addr[2] << 16) |
+						     ((uint32_t)addr[1] << 8) | addr[0]);
+			mac_reg_write(perfect[n][0], ETH_MACA1HR_AE | ((uint32_t)addr[5] << 8) | addr[4]);
+			n++;
+		} else {
+			uint32_t bin = mcast_hash(addr);
+			hash[bin >> 5] |= 1UL << (bin & 31U);
+		}
+	}
+	for ( ; n < ETH_MAC_PERFECT_CNT; n++) {
+		mac_reg_write(perfect[n][0], 0U);
+	}
+	mac_reg_write(&ETH->MACHTHR, hash[1]);
+	mac_reg_write(&ETH->MACHTLR, hash[0]);
+
+	uint32_t ffr = ETH->MACFFR & ~(ETH_MACFFR_PAM | ETH_MACFFR_HPF | ETH_MACFFR_HM);
+	if (s_mcast_overflow != 0U) {
+		ffr |= ETH_MACFFR_PAM;
+	} else if ((hash[0] | hash[1]) != 0U) {
+		/* Pass multicast matching either the perfect filter or the hash */
+		ffr |= ETH_MACFFR_HPF | ETH_MACFFR_HM;
+	}
+	mac_reg_write(&ETH->MACFFR, ffr);
+}
+
+static err_t mcast_filter(const u8_t *addr, enum netif_mac_filter_action action)
+{
+	struct mcast_addr *entry = NULL;
+	struct mcast_addr *unused = NULL;
+
+	for (uint32_t i = 0U; i < ETHIF_MCAST_CNT; i++) {
+		if (s_mcast[i].refcnt == 0U) {
+			if (unused == NULL) {
+				unused = &s_mcast[i];
+			}
+		} else if (memcmp(s_mcast[i].addr, addr, ETHARP_HWADDR_LEN) == 0) {
+			entry = &s_mcast[i];
+			break;
+		}
+	}
+
+	if (action == NETIF_ADD_MAC_FILTER) {
+		if (entry != NULL) {
+			entry->refcnt++;
+		} else if (unused != NULL) {
+			memcpy(unused->addr, addr, ETHARP_HWADDR_LEN);
+			unused->refcnt = 1U;
+		} else {
+			s_mcast_overflow++;
+		}
+	} else {
+		if (entry != NULL) {
+			entry->refcnt--;
+		} else if (s_mcast_overflow != 0U) {
+			s_mcast_overflow--;
+		} else {
+			return ERR_VAL;
+		}
+	}
+
+	mcast_apply();
+	return ERR_OK;
+}
+#endif /* LWIP_IGMP || LWIP_IPV6_MLD */
+
+#if LWIP_IGMP
+/* IPv4 groups map to 01:00:5e and the low 23 bits of the group address */
+static err_t igmp_mac_filter(struct netif *netif, const ip4_addr_t *group,
+			     enum netif_mac_filter_action action)
+{
+	(void)netif;
+	uint32_t ip = lwip_ntohl(ip4_addr_get_u32(group));
+	const u8_t addr[ETHARP_HWADDR_LEN] = {
+		LL_IP4_MULTICAST_ADDR_0, LL_IP4_MULTICAST_ADDR_1, LL_IP4_MULTICAST_ADDR_2,
+		(u8_t)((ip >> 16) & 0x7FU), (u8_t)(ip >> 8), (u8_t)ip
+	};
+
+	return mcast_filter(addr, action);
+}
+#endif /* LWIP_IGMP */
+
+#if LWIP_IPV6_MLD
+/* IPv6 groups map to 33:33 and the low 32 bits of the group address */
+static err_t mld_mac_filter(struct netif *netif, const ip6_addr_t *group,
+			    enum netif_mac_filter_action action)
+{
+	(void)netif;
+	const u8_t *low = (const u8_t *)&group->addr[3];
+	const u8_t addr[ETHARP_HWADDR_LEN] = {
+		LL_IP6_MULTICAST_ADDR_0, LL_IP6_MULTICAST_ADDR_1, low[0], low[1], low[2], low[3]
+	};
+
+	return mcast_filter(addr, action);
+}
+#endif /* LWIP_IPV6_MLD */
+
 static void low_level_init(struct netif *netif)
 {
 	TxConfig.Attributes = ETH_TX_PACKETS_FEATURES_CSUM | ETH_TX_PACKETS_FEATURES_CRCPAD;
 	TxConfig.ChecksumCtrl = ETH_CHECKSUM_IPHDR_PAYLOAD_INSERT_PHDR_CALC;
 	TxConfig.CRCPadCtrl = ETH_CRC_PAD_INSERT;
 
+#if ETHIF_TX_QUEUED
+	s_tx_reclaim_msg = tcpip_callbackmsg_new(tx_reclaim, NULL);
+	LWIP_ASSERT("failed to allocate TX reclaim message", s_tx_reclaim_msg != NULL);
+#endif
+
+#if configSUPPORT_STATIC_ALLOCATION
+	static StaticSemaphore_t rx_batch_sem_buf;
+	s_rx_batch_sem = xSemaphoreCreateCountingStatic(2U, 2U, &rx_batch_sem_buf);
+#else
+	s_rx_batch_sem = xSemaphoreCreateCounting(2U, 2U);
+#endif
+	LWIP_ASSERT("failed to create RX batch semaphore", s_rx_batch_sem != NULL);
+	for (u32_t i = 0U; i < 2U; i++) {
+		s_rx_batch[i].msg = tcpip_callbackmsg_new(rx_batch_input, &s_rx_batch[i]);
+		LWIP_ASSERT("failed to allocate RX batch message", s_rx_batch[i].msg != NULL);
+	}
+
 	netif->flags |= NETIF_FLAG_LINK_UP;
 
 	/* set MAC hardware address length */
@@ -255,8 +805,26 @@ static void low_level_init(struct netif *netif)
 	/* don't set NETIF_FLAG_ETHARP if this device is not an ethernet one */
 	netif->flags |= NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP;
 
+	/* Multicast is filtered by the MAC, see mcast_filter() */
+#if LWIP_IGMP
+	netif->flags |= NETIF_FLAG_IGMP;
+	netif_set_igmp_mac_filter(netif, igmp_mac_filter);
+#endif
+#if LWIP_IPV6_MLD
+	netif->flags |= NETIF_FLAG_MLD6;
+	netif_set_mld_mac_filter(netif, mld_mac_filter);
+#endif
+
+#if ETHIF_RX_POLLING
 	/* Enable MAC and DMA transmission and reception */
 	HAL_ETH_Start(&s_heth);
+#else
+	HAL_NVIC_SetPriority(ETH_IRQn, ETH_IRQ_PRIORITY, 0U);
+	HAL_NVIC_EnableIRQ(ETH_IRQn);
+
+	/* Enable MAC and DMA transmission and reception with interrupts */
+	HAL_ETH_Start_IT(&s_heth);
+#endif /* ETHIF_RX_POLLING */
 }
 
 err_t ethernetif_init(struct netif *netif)
@@ -298,6 +866,9 @@ err_t ethernetif_init(struct netif *netif)
 	netif->linkoutput = low_level_output;
 
 	LWIP_MEMPOOL_INIT(RX_POOL);
+#if ETH_RX_SMALL_BUFFER_SIZE
+	LWIP_MEMPOOL_INIT(RX_SMALL_POOL);
+#endif
 
 	/* initialize the hardware */
 	low_level_init(netif);
@@ -308,21 +879,50 @@ err_t ethernetif_init(struct netif *netif)
 static void pbuf_free_custom(struct pbuf *p)
 {
 	struct pbuf_custom* custom_pbuf = (struct pbuf_custom*)p;
+	SYS_ARCH_DECL_PROTECT(old_level);
+
+	TRACE(TRACE_RX_FREE, p);
 	LWIP_MEMPOOL_FREE(RX_POOL, custom_pbuf);
 
+	SYS_ARCH_PROTECT(old_level);
+	s_rx_pool_stats.used--;
+	SYS_ARCH_UNPROTECT(old_level);
+
 	/* If the Rx Buffer Pool was exhausted, signal the ethernetif_input task to
 	 * call HAL_ETH_GetRxDataBuffer to rebuild the Rx descriptors. */
 	__asm volatile ("dmb" : : : "memory");
 	if (RxAllocStatus == RX_ALLOC_ERROR) {
 		RxAllocStatus = RX_ALLOC_OK;
 		__asm volatile ("dmb" : : : "memory");
+#if !ETHIF_RX_POLLING
+		/* DMA may be suspended without free descriptors,
+		 * so no receive interrupt is going to wake the input task */
+		if (s_rx_task != NULL) {
+			xTaskNotifyGive(s_rx_task);
+		}
+#endif /* !ETHIF_RX_POLLING */
 	}
 }
 
 void HAL_ETH_RxAllocateCallback(uint8_t **buff)
 {
 	struct pbuf_custom *p = LWIP_MEMPOOL_ALLOC(RX_POOL);
+	SYS_ARCH_DECL_PROTECT(old_level);
+
+	SYS_ARCH_PROTECT(old_level);
+	if (p) {
+		s_rx_pool_stats.used++;
+		if (s_rx_pool_stats.used > s_rx_pool_stats.high_water) {
+			s_rx_pool_stats.high_water = s_rx_pool_stats.used;
+		}
+	} else {
+		s_rx_pool_stats.exhausted++;
+	}
+	SYS_ARCH_UNPROTECT(old_level);
+
 	if (p) {
+		TRACE(TRACE_RX_ALLOC, p);
+
 		/* Get the buff from the struct pbuf address. */
 		*buff = (uint8_t *)p + offsetof(RxBuff_t, buff);
 		p->custom_free_function = pbuf_free_custom;
@@ -330,7 +930,7 @@ void HAL_ETH_RxAllocateCallback(uint8_t **buff)
 		/* Initialize the struct pbuf.
 		 * This must be performed whenever a buffer's allocated because it may be
 		 * changed by lwIP or the app, e.g., pbuf_free decrements ref. */
-		pbuf_alloced_custom(PBUF_RAW, 0, PBUF_REF, p, *buff, ETH_RX_BUF_SIZE);
+		pbuf_alloced_custom(PBUF_RAW, 0, PBUF_REF, p, *buff, ETH_RX_BUFFER_SIZE);
 	} else {
 		RxAllocStatus = RX_ALLOC_ERROR;
 		__asm volatile ("dmb" : : : "memory");
@@ -346,8 +946,9 @@ void HAL_ETH_RxLinkCallback(void **pStart, void **pEnd, uint8_t *buff, uint16_t
 
 	/* Get the struct pbuf from the buff address. */
 	p = (struct pbuf *)(buff - offsetof(RxBuff_t, buff));
+	TRACE(TRACE_RX_LINK, p);
 	p->next = NULL;
-	p->tot_len = 0;
+	p->tot_len = Length;
 	p->len = Length;
 
 	/* Chain the buffer. */
@@ -355,18 +956,183 @@ void HAL_ETH_RxLinkCallback(void **pStart, void **pEnd, uint8_t *buff, uint16_t
 		/* The first buffer of the packet. */
 		*ppStart = p;
 	} else {
-		/* Chain the buffer to the end of the packet. */
+		/* Chain the buffer to the end of the packet.
+		 * Only the head accumulates the length of the whole chain here,
+		 * tot_len of the following pbufs is fixed up by rx_chain_fixup()
+		 * once the last buffer of the packet is received. */
 		(*ppEnd)->next = p;
+		(*ppStart)->tot_len = (uint16_t)((*ppStart)->tot_len + Length);
 	}
 	*ppEnd  = p;
+}
+
+#if ETHIF_PCAP
+/* Copies a frame into an RX pool buffer as if it was received by the MAC */
+struct pbuf *ethif_rx_pbuf(const void *data, uint16_t len)
+{
+	uint8_t *buff = NULL;
+
+	if (len > ETH_RX_BUFFER_SIZE) {
+		return NULL;
+	}
+
+	HAL_ETH_RxAllocateCallback(&buff);
+	if (buff == NULL) {
+		return NULL;
+	}
+
+	struct pbuf *p = (struct pbuf *)(buff - offsetof(RxBuff_t, buff));
+	memcpy(buff, data, len);
+	p->next = NULL;
+	p->len = len;
+	p->tot_len = len;
+#if ETHIF_PTP
+	if (ethptp_get_time(&((RxBuff_t *)p)->ts) != HAL_OK) {
+		memset(&((RxBuff_t *)p)->ts, 0, sizeof(((RxBuff_t *)p)->ts));
+	}
+#endif
+
+	return p;
+}
+#endif /* ETHIF_PCAP */
 
-	/* Update the total length of all the buffers of the chain. Each pbuf in the chain should have its tot_len
-	 * set to its own length, plus the length of all the following pbufs in the chain. */
-	for (p = *ppStart; p != NULL; p = p->next) {
-		p->tot_len = (uint16_t)(p->tot_len + Length);
+#if ETHIF_PTP
+/* Gets the receive time of a frame from its first pbuf, which lwIP hands on
+ * to the protocol callbacks with the payload moved past the headers.
+ * Returns 0 if p was not received by this driver. */
+int ethif_rx_timestamp(const struct pbuf *p, struct ethptp_time *ts)
+{
+	if ((p->flags & PBUF_FLAG_IS_CUSTOM) == 0U) {
+		return 0;
+	}
+
+	const struct pbuf_custom *pc = (const struct pbuf_custom *)p;
+	if (pc->custom_free_function == pbuf_free_custom) {
+		*ts = ((const RxBuff_t *)p)->ts;
+#if ETH_RX_SMALL_BUFFER_SIZE
+	} else if (pc->custom_free_function == pbuf_free_small) {
+		*ts = ((const RxSmallBuff_t *)p)->ts;
+#endif
+	} else {
+		return 0;
+	}
+	return 1;
+}
+#endif /* ETHIF_PTP */
+
+void ethif_get_rx_pool_stats(struct ethif_rx_pool_stats *stats)
+{
+	SYS_ARCH_DECL_PROTECT(old_level);
+
+	SYS_ARCH_PROTECT(old_level);
+	*stats = s_rx_pool_stats;
+	SYS_ARCH_UNPROTECT(old_level);
+	stats->size = ETH_RX_BUFFER_CNT;
+}
+
+void ethif_wait_rx(void)
+{
+#if ETHIF_RX_POLLING
+	vTaskDelay(pdMS_TO_TICKS(ETHIF_RX_POLL_PERIOD_MS));
+#else
+	if (s_rx_task == NULL) {
+		s_rx_task = xTaskGetCurrentTaskHandle();
+		__asm volatile ("dmb" : : : "memory");
 	}
+	(void)ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ETHIF_RX_WAIT_TIMEOUT_MS));
+#endif /* ETHIF_RX_POLLING */
 }
 
+/* Drains up to ETHIF_RX_BATCH frames from the DMA and hands them to the tcpip
+ * thread with a single message. Returns the number of frames drained, so a
+ * return of ETHIF_RX_BATCH means more frames may be pending. */
+u32_t ethif_input_batch(struct netif *netif)
+{
+	struct rx_batch *batch = &s_rx_batch[s_rx_batch_idx];
+	struct pbuf *p = NULL;
+	u32_t cnt = 0U;
+
+	/* Wait until the tcpip thread is done with the older batch */
+	(void)xSemaphoreTake(s_rx_batch_sem, portMAX_DELAY);
+
+	while (cnt < ETHIF_RX_BATCH) {
+		p = low_level_input(netif);
+		if (p == NULL) {
+			break;
+		}
+		batch->p[cnt++] = p;
+	}
+
+	if (cnt == 0U) {
+		(void)xSemaphoreGive(s_rx_batch_sem);
+		return 0U;
+	}
+
+	batch->netif = netif;
+	batch->cnt = cnt;
+	if (tcpip_callbackmsg_trycallback(batch->msg) != ERR_OK) {
+		/* tcpip mailbox is full, drop the frames as tcpip_input() would */
+		for (u32_t i = 0U; i < cnt; i++) {
+			pbuf_free(batch->p[i]);
+		}
+		batch->cnt = 0U;
+		(void)xSemaphoreGive(s_rx_batch_sem);
+		return cnt;
+	}
+
+	s_rx_batch_idx ^= 1U;
+	return cnt;
+}
+
+void HAL_ETH_RxCpltCallback(ETH_HandleTypeDef *heth)
+{
+	(void)heth;
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	if (s_rx_task != NULL) {
+		vTaskNotifyGiveFromISR(s_rx_task, &xHigherPriorityTaskWoken);
+	}
+	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+void ETH_IRQHandler(void)
+{
+	HAL_ETH_IRQHandler(&s_heth);
+}
+
+#if !ETHIF_PHY_POLLING
+static void ethphy_irq_init(void)
+{
+	GPIO_InitTypeDef gpio = { 0 };
+
+	__HAL_RCC_GPIOE_CLK_ENABLE();
+
+	gpio.Speed = GPIO_SPEED_FREQ_LOW;
+	gpio.Mode = GPIO_MODE_IT_FALLING;
+	gpio.Pull = GPIO_PULLUP;
+	gpio.Pin = RMII_PHY_INT_PIN;
+	HAL_GPIO_Init(RMII_PHY_INT_PORT, &gpio);
+
+	HAL_NVIC_SetPriority(RMII_PHY_INT_IRQn, ETH_IRQ_PRIORITY, 0U);
+	HAL_NVIC_EnableIRQ(RMII_PHY_INT_IRQn);
+}
+
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	if ((GPIO_Pin == RMII_PHY_INT_PIN) && (s_link_task != NULL)) {
+		vTaskNotifyGiveFromISR(s_link_task, &xHigherPriorityTaskWoken);
+	}
+	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+void EXTI9_5_IRQHandler(void)
+{
+	HAL_GPIO_EXTI_IRQHandler(RMII_PHY_INT_PIN);
+}
+#endif /* !ETHIF_PHY_POLLING */
+
 void ethmac_init(void)
 {
 	static uint8_t MACAddr[6] = {
@@ -386,23 +1152,108 @@ void ethmac_init(void)
 	s_heth.Init.MediaInterface = HAL_ETH_RMII_MODE;
 	s_heth.Init.TxDesc = DMATxDscrTab;
 	s_heth.Init.RxDesc = DMARxDscrTab;
-	s_heth.Init.RxBuffLen = 1536;
+	s_heth.Init.RxBuffLen = ETH_RX_BUFFER_SIZE;
 
 	HAL_ETH_Init(&s_heth);
+#if ETHIF_PTP
+	HAL_StatusTypeDef status = ethptp_init(&s_heth);
+	LWIP_ASSERT("failed to start the PTP clock", status == HAL_OK);
+	(void)status;
+#endif
+
+	s_phy = ethphy_probe(&s_heth);
+	(void)s_phy->init(&s_heth);
+#if !ETHIF_PHY_POLLING
+	if (s_phy->has_irq) {
+		ethphy_irq_init();
+	}
+#endif
+}
+
+/* Follows the speed and duplex negotiated by the PHY, otherwise the MAC stays
+ * in its HAL_ETH_Init() defaults (100 Mbit/s, full duplex). The HAL only
+ * changes the MAC configuration while the MAC is stopped, so it is stopped
+ * and restarted around the change with the tcpip core locked, no frame is
+ * sent in between. */
+static HAL_StatusTypeDef ethmac_update_mode(void)
+{
+	struct ethphy_mode mode;
+	ETH_MACConfigTypeDef mac_config;
+
+	if (s_phy->get_mode(&s_heth, &mode) != HAL_OK) {
+		return HAL_ERROR;
+	}
+
+	LOCK_TCPIP_CORE();
+	HAL_StatusTypeDef status = HAL_ETH_GetMACConfig(&s_heth, &mac_config);
+	if ((status == HAL_OK)
+			&& ((mac_config.Speed != mode.speed) || (mac_config.DuplexMode != mode.duplex))) {
+		mac_config.Speed = mode.speed;
+		mac_config.DuplexMode = mode.duplex;
+#if ETHIF_RX_POLLING
+		status = HAL_ETH_Stop(&s_heth);
+#else
+		status = HAL_ETH_Stop_IT(&s_heth);
+#endif
+		if (status == HAL_OK) {
+			status = HAL_ETH_SetMACConfig(&s_heth, &mac_config);
+			/* Restart even if the configuration failed, the MAC keeps
+			 * its previous mode */
+#if ETHIF_RX_POLLING
+			HAL_StatusTypeDef start = HAL_ETH_Start(&s_heth);
+#else
+			HAL_StatusTypeDef start = HAL_ETH_Start_IT(&s_heth);
+#endif
+			if (status == HAL_OK) {
+				status = start;
+			}
+		}
+	}
+	UNLOCK_TCPIP_CORE();
+
+	return status;
 }
 
 enum link_status ethphy_getlink(void)
 {
-	uint32_t regval = 0;
-	HAL_StatusTypeDef status = HAL_ETH_ReadPHYRegister(&s_heth, 0, PHY_INTERRUPT_STATUS, &regval);
-	if (status == HAL_OK) {
-		if (regval & PHY_LINK_INT_UP_OCCURRED) {
-			return LINK_UP;
-		} else if (regval & PHY_LINK_INT_DOWN_OCCURED) {
-			return LINK_DOWN;
+	return s_phy->irq_ack(&s_heth);
+}
+
+enum link_status ethphy_wait_link(void)
+{
+#if ETHIF_PHY_POLLING
+	vTaskDelay(pdMS_TO_TICKS(ETHIF_PHY_POLL_PERIOD_MS));
+#else
+	if (!s_phy->has_irq) {
+		vTaskDelay(pdMS_TO_TICKS(ETHIF_PHY_POLL_PERIOD_MS));
+	} else if (s_link_task == NULL) {
+		/* Read out the status latched before the first wait */
+		s_link_task = xTaskGetCurrentTaskHandle();
+		__asm volatile ("dmb" : : : "memory");
+	} else if ((ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ETHIF_PHY_WAIT_TIMEOUT_MS)) != 0U)
+			&& (ETHIF_PHY_DEBOUNCE_MS > 0U)) {
+		vTaskDelay(pdMS_TO_TICKS(ETHIF_PHY_DEBOUNCE_MS));
+		/* Drop the interrupts raised while debouncing */
+		(void)ulTaskNotifyTake(pdTRUE, 0);
+	}
+#endif /* ETHIF_PHY_POLLING */
+
+	enum link_status link = ethphy_getlink();
+	if (link == LINK_DOWN) {
+		s_mac_mode_pending = 0;
+	} else if ((link == LINK_UP) || ((link == LINK_UNCHANGED) && s_mac_mode_pending)) {
+		/* The link is reported up once the MAC follows the PHY mode,
+		 * a failed update is retried on the next call */
+		if (ethmac_update_mode() != HAL_OK) {
+			s_mac_mode_pending = 1;
+			link = LINK_ERROR;
 		} else {
-			return LINK_UNCHANGED;
+			s_mac_mode_pending = 0;
+			link = LINK_UP;
 		}
+	} else {
+		/* No action */
 	}
-	return LINK_ERROR;
+
+	return link;
 }
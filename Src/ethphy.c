@@ -0,0 +1,210 @@
+#include "ethphy.h"
+
+
+#define KSZ8081_PHY_ID1				((uint32_t)0x0022)
+#define KSZ8081_PHY_ID2				((uint32_t)0x1560)
+#define PHY_ID2_MODEL_MASK			((uint32_t)0xFFF0)
+
+
+static enum link_status clause22_get_link(ETH_HandleTypeDef *heth)
+{
+	uint32_t regval = 0;
+
+	/* Link status is latched low, the second read returns the current state */
+	(void)HAL_ETH_ReadPHYRegister(heth, ETH_PHY_ADDR, PHY_BASIC_STATUS, &regval);
+	HAL_StatusTypeDef status = HAL_ETH_ReadPHYRegister(heth, ETH_PHY_ADDR, PHY_BASIC_STATUS, &regval);
+	if (status != HAL_OK) {
+		return LINK_ERROR;
+	}
+
+	return (regval & PHY_LINKED_STATUS) ? LINK_UP : LINK_DOWN;
+}
+
+static HAL_StatusTypeDef clause22_init(ETH_HandleTypeDef *heth)
+{
+	uint32_t regval = 0;
+
+	HAL_StatusTypeDef status = HAL_ETH_ReadPHYRegister(heth, ETH_PHY_ADDR, PHY_BASIC_CONTROL, &regval);
+	if ((status != HAL_OK) || (regval & PHY_AUTONEG_ENABLE)) {
+		return status;
+	}
+
+	regval |= PHY_AUTONEG_ENABLE | PHY_AUTONEG_RESTART;
+	return HAL_ETH_WritePHYRegister(heth, ETH_PHY_ADDR, PHY_BASIC_CONTROL, regval);
+}
+
+static HAL_StatusTypeDef clause22_get_mode(ETH_HandleTypeDef *heth, struct ethphy_mode *mode)
+{
+	uint32_t bcr = 0;
+	uint32_t bsr = 0;
+	uint32_t anar = 0;
+	uint32_t anlpar = 0;
+
+	HAL_StatusTypeDef status = HAL_ETH_ReadPHYRegister(heth, ETH_PHY_ADDR, PHY_BASIC_CONTROL, &bcr);
+	if (status != HAL_OK) {
+		return status;
+	}
+
+	if ((bcr & PHY_AUTONEG_ENABLE) == 0U) {
+		/* Forced mode */
+		mode->speed = (bcr & PHY_SPEED_100M_SELECT) ? ETH_SPEED_100M : ETH_SPEED_10M;
+		mode->duplex = (bcr & PHY_FULLDUPLEX_SELECT) ? ETH_FULLDUPLEX_MODE : ETH_HALFDUPLEX_MODE;
+		return HAL_OK;
+	}
+
+	status = HAL_ETH_ReadPHYRegister(heth, ETH_PHY_ADDR, PHY_BASIC_STATUS, &bsr);
+	if (status != HAL_OK) {
+		return status;
+	}
+	if ((bsr & PHY_AUTONEG_COMPLETE) == 0U) {
+		return HAL_BUSY;
+	}
+
+	status = HAL_ETH_ReadPHYRegister(heth, ETH_PHY_ADDR, PHY_AUTONEG_ADVERTISEMENT, &anar);
+	if (status != HAL_OK) {
+		return status;
+	}
+	status = HAL_ETH_ReadPHYRegister(heth, ETH_PHY_ADDR, PHY_AUTONEG_LINK_PARTNER_ABILITY, &anlpar);
+	if (status != HAL_OK) {
+		return status;
+	}
+
+	/* Highest common denominator in 802.3 priority order */
+	uint32_t common = anar & anlpar;
+	if (common & PHY_ABILITY_100BASE_TX_FD) {
+		mode->speed = ETH_SPEED_100M;
+		mode->duplex = ETH_FULLDUPLEX_MODE;
+	} else if (common & PHY_ABILITY_100BASE_TX) {
+		mode->speed = ETH_SPEED_100M;
+		mode->duplex = ETH_HALFDUPLEX_MODE;
+	} else if (common & PHY_ABILITY_10BASE_T_FD) {
+		mode->speed = ETH_SPEED_10M;
+		mode->duplex = ETH_FULLDUPLEX_MODE;
+	} else if (common & PHY_ABILITY_10BASE_T) {
+		mode->speed = ETH_SPEED_10M;
+		mode->duplex = ETH_HALFDUPLEX_MODE;
+	} else {
+		return HAL_ERROR;
+	}
+
+	return HAL_OK;
+}
+
+/* No interrupt source in clause 22, a link change is detected by comparing
+ * with the state seen on the previous call */
+static enum link_status clause22_irq_ack(ETH_HandleTypeDef *heth)
+{
+	static enum link_status last = LINK_DOWN;
+
+	enum link_status link = clause22_get_link(heth);
+	if (link == LINK_ERROR) {
+		return LINK_ERROR;
+	} else if (link == last) {
+		return LINK_UNCHANGED;
+	}
+
+	last = link;
+	return link;
+}
+
+const struct ethphy_drv ethphy_generic = {
+	.name = "clause22",
+	.has_irq = 0,
+	.init = clause22_init,
+	.get_link = clause22_get_link,
+	.get_mode = clause22_get_mode,
+	.irq_ack = clause22_irq_ack
+};
+
+
+static HAL_StatusTypeDef ksz8081_init(ETH_HandleTypeDef *heth)
+{
+	HAL_StatusTypeDef status = clause22_init(heth);
+	if (status != HAL_OK) {
+		return status;
+	}
+
+	/* Drive the INTRP pin (active low) on link up and link down */
+	return HAL_ETH_WritePHYRegister(heth, ETH_PHY_ADDR, PHY_INTERRUPT_CONTROL,
+				PHY_LINK_INT_UP_ENABLE | PHY_LINK_INT_DOWN_ENABLE);
+}
+
+static HAL_StatusTypeDef ksz8081_get_mode(ETH_HandleTypeDef *heth, struct ethphy_mode *mode)
+{
+	uint32_t regval = 0;
+
+	HAL_StatusTypeDef status = HAL_ETH_ReadPHYRegister(heth, ETH_PHY_ADDR, PHY_CONTROL1, &regval);
+	if (status != HAL_OK) {
+		return status;
+	}
+
+	switch (regval & PHY_OPERATION_MODE_MASK) {
+	case PHY_OPERATION_MODE_10BASE_T:
+		mode->speed = ETH_SPEED_10M;
+		mode->duplex = ETH_HALFDUPLEX_MODE;
+		break;
+	case PHY_OPERATION_MODE_100BASE_TX:
+		mode->speed = ETH_SPEED_100M;
+		mode->duplex = ETH_HALFDUPLEX_MODE;
+		break;
+	case PHY_OPERATION_MODE_10BASE_T_FD:
+		mode->speed = ETH_SPEED_10M;
+		mode->duplex = ETH_FULLDUPLEX_MODE;
+		break;
+	case PHY_OPERATION_MODE_100BASE_TX_FD:
+		mode->speed = ETH_SPEED_100M;
+		mode->duplex = ETH_FULLDUPLEX_MODE;
+		break;
+	default:
+		/* Still autonegotiating */
+		return HAL_BUSY;
+	}
+
+	return HAL_OK;
+}
+
+static enum link_status ksz8081_irq_ack(ETH_HandleTypeDef *heth)
+{
+	uint32_t regval = 0;
+
+	/* Reading the status clears the interrupt and releases the INTRP pin */
+	HAL_StatusTypeDef status = HAL_ETH_ReadPHYRegister(heth, ETH_PHY_ADDR, PHY_INTERRUPT_STATUS, &regval);
+	if (status == HAL_OK) {
+		if ((regval & PHY_LINK_INT_UP_OCCURRED) && (regval & PHY_LINK_INT_DOWN_OCCURED)) {
+			/* The link flapped since the last read, report its current state */
+			return clause22_get_link(heth);
+		} else if (regval & PHY_LINK_INT_UP_OCCURRED) {
+			return LINK_UP;
+		} else if (regval & PHY_LINK_INT_DOWN_OCCURED) {
+			return LINK_DOWN;
+		} else {
+			return LINK_UNCHANGED;
+		}
+	}
+	return LINK_ERROR;
+}
+
+const struct ethphy_drv ethphy_ksz8081 = {
+	.name = "KSZ8081",
+	.has_irq = 1,
+	.init = ksz8081_init,
+	.get_link = clause22_get_link,
+	.get_mode = ksz8081_get_mode,
+	.irq_ack = ksz8081_irq_ack
+};
+
+
+const struct ethphy_drv *ethphy_probe(ETH_HandleTypeDef *heth)
+{
+	uint32_t id1 = 0;
+	uint32_t id2 = 0;
+
+	if ((HAL_ETH_ReadPHYRegister(heth, ETH_PHY_ADDR, PHY_IDENTIFIER1, &id1) == HAL_OK)
+			&& (HAL_ETH_ReadPHYRegister(heth, ETH_PHY_ADDR, PHY_IDENTIFIER2, &id2) == HAL_OK)
+			&& (id1 == KSZ8081_PHY_ID1)
+			&& ((id2 & PHY_ID2_MODEL_MASK) == KSZ8081_PHY_ID2)) {
+		return &ethphy_ksz8081;
+	}
+
+	return &ethphy_generic;
+}
@@ -0,0 +1,150 @@
+#include "stm32f4xx_hal.h"
+
+#include "ethif.h"
+#include "ethptp.h"
+
+#if ETHIF_PTP
+
+#ifndef HAL_ETH_USE_PTP
+#error "ETHIF_PTP requires HAL_ETH_USE_PTP, define ETHIF_PTP on the compiler command line"
+#endif
+
+/* PTPTSCR update bits, RM0090 33.8.5. The HAL has no addend-only update and
+ * no wait for the updates it starts, so they are used directly. */
+#define PTPTSCR_TSSTI				(1UL << 2)	/* initialize time */
+#define PTPTSCR_TSSTU				(1UL << 3)	/* add/subtract update */
+#define PTPTSCR_TTSARU				(1UL << 5)	/* addend update */
+#define PTPTSCR_TSSSR				(1UL << 9)	/* subseconds roll over at 10^9 */
+/* PTPTSLUR sign bit, the update is subtracted if set */
+#define PTPTSLUR_TSUPNS				(1UL << 31)
+
+#define NSEC_PER_SEC				1000000000LL
+
+/* With digital rollover the subsecond counter counts nanoseconds. It is
+ * incremented by ETHPTP_SUBSEC_INC whenever the 32-bit accumulator fed with
+ * the addend on every HCLK cycle overflows, so the nominal addend makes it
+ * overflow at 10^9 / ETHPTP_SUBSEC_INC Hz. */
+#define ETHPTP_SUBSEC_INC			20U
+#define ETHPTP_UPDATE_HZ			(1000000000ULL / ETHPTP_SUBSEC_INC)
+
+/* Register updates complete within a few PTP clock cycles */
+#define ETHPTP_UPDATE_TIMEOUT			10000U
+
+static ETH_HandleTypeDef *s_heth;
+static uint32_t s_addend;
+
+/* Waits until the MAC has taken over the updates in bits */
+static HAL_StatusTypeDef wait_update(uint32_t bits)
+{
+	for (uint32_t i = 0U; i < ETHPTP_UPDATE_TIMEOUT; i++) {
+		if ((s_heth->Instance->PTPTSCR & bits) == 0U) {
+			return HAL_OK;
+		}
+	}
+	return HAL_TIMEOUT;
+}
+
+/* Starts the system time counter at 0 with fine correction and digital
+ * rollover, and timestamps every received frame. Must be called after
+ * HAL_ETH_Init(). */
+HAL_StatusTypeDef ethptp_init(ETH_HandleTypeDef *heth)
+{
+	ETH_PTP_ConfigTypeDef config = { 0 };
+
+	s_heth = heth;
+	s_addend = (uint32_t)((ETHPTP_UPDATE_HZ << 32) / HAL_RCC_GetHCLKFreq());
+
+	config.Timestamp = ENABLE;
+	config.TimestampUpdateMode = ENABLE;
+	config.TimestampInitialize = ENABLE;
+	config.TimestampAddendUpdate = ENABLE;
+	config.TimestampAll = ENABLE;
+	config.TimestampRolloverMode = ENABLE;
+	config.TimestampV2 = ENABLE;
+	config.TimestampIPv4 = ENABLE;
+	config.TimestampAddend = s_addend;
+	config.TimestampSubsecondInc = ETHPTP_SUBSEC_INC;
+	if (HAL_ETH_PTP_SetConfig(heth, &config) != HAL_OK) {
+		return HAL_ERROR;
+	}
+
+	return wait_update(PTPTSCR_TSSTI | PTPTSCR_TTSARU);
+}
+
+HAL_StatusTypeDef ethptp_get_time(struct ethptp_time *time)
+{
+	ETH_TimeTypeDef t;
+	ETH_TimeTypeDef again;
+
+	/* Read again if the seconds incremented in between */
+	do {
+		if ((HAL_ETH_PTP_GetTime(s_heth, &t) != HAL_OK) ||
+		    (HAL_ETH_PTP_GetTime(s_heth, &again) != HAL_OK)) {
+			return HAL_ERROR;
+		}
+	} while (t.Seconds != again.Seconds);
+
+	time->sec = t.Seconds;
+	time->nsec = t.NanoSeconds;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef ethptp_set_time(const struct ethptp_time *time)
+{
+	ETH_TimeTypeDef t = { .Seconds = time->sec, .NanoSeconds = time->nsec };
+
+	if (wait_update(PTPTSCR_TSSTI | PTPTSCR_TSSTU) != HAL_OK) {
+		return HAL_TIMEOUT;
+	}
+	if (HAL_ETH_PTP_SetTime(s_heth, &t) != HAL_OK) {
+		return HAL_ERROR;
+	}
+	return wait_update(PTPTSCR_TSSTI);
+}
+
+/* Steps the clock by ns, positive values move it forward */
+HAL_StatusTypeDef ethptp_adjust_offset(int64_t ns)
+{
+	uint64_t abs_ns = (uint64_t)((ns < 0) ? -ns : ns);
+	uint32_t sec = (uint32_t)(abs_ns / (uint64_t)NSEC_PER_SEC);
+	uint32_t nsec = (uint32_t)(abs_ns % (uint64_t)NSEC_PER_SEC);
+
+	if (ns < 0) {
+		/* With digital rollover a subtracted subsecond value is written
+		 * as its complement to 10^9, as in the stmmac driver */
+		if (((s_heth->Instance->PTPTSCR & PTPTSCR_TSSSR) != 0U) && (nsec != 0U)) {
+			nsec = (uint32_t)NSEC_PER_SEC - nsec;
+		}
+		nsec |= PTPTSLUR_TSUPNS;
+	}
+
+	if (wait_update(PTPTSCR_TSSTI | PTPTSCR_TSSTU) != HAL_OK) {
+		return HAL_TIMEOUT;
+	}
+	s_heth->Instance->PTPTSHUR = sec;
+	s_heth->Instance->PTPTSLUR = nsec;
+	s_heth->Instance->PTPTSCR |= PTPTSCR_TSSTU;
+	return wait_update(PTPTSCR_TSSTU);
+}
+
+/* Runs the clock ppb parts per billion faster than nominal, or slower if
+ * negative. Replaces the previous adjustment. */
+HAL_StatusTypeDef ethptp_adjust_freq(int32_t ppb)
+{
+	if (ppb > ETHPTP_MAX_PPB) {
+		ppb = ETHPTP_MAX_PPB;
+	} else if (ppb < -ETHPTP_MAX_PPB) {
+		ppb = -ETHPTP_MAX_PPB;
+	}
+
+	int64_t delta = ((int64_t)s_addend * ppb) / NSEC_PER_SEC;
+
+	if (wait_update(PTPTSCR_TTSARU) != HAL_OK) {
+		return HAL_TIMEOUT;
+	}
+	s_heth->Instance->PTPTSAR = (uint32_t)((int64_t)s_addend + delta);
+	s_heth->Instance->PTPTSCR |= PTPTSCR_TTSARU;
+	return HAL_OK;
+}
+
+#endif /* ETHIF_PTP */
@@ -0,0 +1,616 @@
+#include <string.h>
+
+#include "lwip/def.h"
+#include "lwip/pbuf.h"
+#include "lwip/stats.h"
+#include "lwip/tcp.h"
+#include "lwip/timeouts.h"
+#include "lwip/udp.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "iperf.h"
+
+#if IPERF_PORT
+
+/* iperf2 wire format, all fields in network byte order */
+#define IPERF_HEADER_VERSION1			0x80000000UL
+#define IPERF_RUN_NOW				0x00000001UL
+
+/* Duration of a send test if the client sets neither time nor amount */
+#define IPERF_DEFAULT_MS			10000U
+/* UDP send rate if the client sets none, in bit/s */
+#define IPERF_DEFAULT_RATE			1000000U
+/* Number of final datagrams sent at the end of a UDP send test */
+#define IPERF_UDP_FIN_CNT			10U
+/* A UDP receive test ends if no datagram arrives for this long, in case all
+ * final datagrams of the client are lost */
+#define IPERF_UDP_IDLE_MS			3000U
+
+/* Sent at the start of a TCP stream and after struct iperf_udp_hdr */
+struct iperf_client_hdr {
+	u32_t flags;
+	u32_t num_threads;
+	u32_t port;		/* for dual and tradeoff tests */
+	u32_t buffer_len;
+	u32_t win_band;		/* UDP rate in bit/s */
+	u32_t amount;		/* bytes, or 10 ms units if negative */
+};
+
+struct iperf_udp_hdr {
+	u32_t id;		/* negative in the final datagrams */
+	u32_t tv_sec;
+	u32_t tv_usec;
+};
+
+/* Reply to the final datagram of a UDP test, after struct iperf_udp_hdr */
+struct iperf_server_hdr {
+	u32_t flags;
+	u32_t total_len1;
+	u32_t total_len2;
+	u32_t stop_sec;
+	u32_t stop_usec;
+	u32_t error_cnt;
+	u32_t outorder_cnt;
+	u32_t datagrams;
+	u32_t jitter1;
+	u32_t jitter2;
+};
+
+struct iperf_run {
+	struct iperf_report cur;
+	u32_t start;
+	configRUN_TIME_COUNTER_TYPE idle;
+	configRUN_TIME_COUNTER_TYPE total;
+	u32_t retransmits;
+	u8_t active;
+};
+
+/* Limit of a send test */
+struct iperf_limit {
+	u32_t bytes;		/* 0 if limited by time */
+	u32_t ms;
+};
+
+#if !LWIP_STATS || !MIB2_STATS
+#error "IPERF_PORT counts retransmits in MIB2_STATS, define IPERF_PORT on the compiler command line"
+#endif
+
+#define IPERF_RETRANSMITS()			lwip_stats.mib2.tcpretranssegs
+
+/* Payload of all send tests. It is never written, so TCP and UDP reference it
+ * instead of copying it into every segment. */
+static u8_t s_tx_buf[IPERF_TX_BUF_SIZE];
+
+static struct iperf_run s_run[IPERF_TEST_CNT];
+static struct iperf_report s_report[IPERF_TEST_CNT];
+
+static struct tcp_pcb *s_tcp_rx;
+static struct iperf_client_hdr s_tcp_hdr;
+static u32_t s_tcp_hdr_len;
+
+static struct tcp_pcb *s_tcp_tx;
+static struct iperf_limit s_tcp_tx_limit;
+static u32_t s_tcp_tx_queued;
+
+static struct udp_pcb *s_udp_rx;
+static struct iperf_client_hdr s_udp_hdr;
+static ip_addr_t s_udp_peer;
+static u16_t s_udp_peer_port;
+static s32_t s_udp_last_id;
+static s32_t s_udp_last_transit;
+static u32_t s_udp_jitter_us;
+static u8_t s_udp_tradeoff;
+
+static struct udp_pcb *s_udp_tx;
+static struct iperf_limit s_udp_tx_limit;
+static u32_t s_udp_tx_rate;
+static u16_t s_udp_tx_len;
+static s32_t s_udp_tx_id;
+static u32_t s_udp_tx_fin;
+
+static void run_begin(enum iperf_test test)
+{
+	struct iperf_run *run = &s_run[test];
+
+	memset(&run->cur, 0, sizeof(run->cur));
+	run->start = sys_now();
+	run->idle = ulTaskGetIdleRunTimeCounter();
+	run->total = portGET_RUN_TIME_COUNTER_VALUE();
+	run->retransmits = IPERF_RETRANSMITS();
+	run->active = 1U;
+}
+
+static void run_end(enum iperf_test test)
+{
+	struct iperf_run *run = &s_run[test];
+	struct iperf_report *cur = &run->cur;
+
+	if (!run->active) {
+		return;
+	}
+	run->active = 0U;
+
+	configRUN_TIME_COUNTER_TYPE total = (configRUN_TIME_COUNTER_TYPE)(portGET_RUN_TIME_COUNTER_VALUE() - run->total);
+	configRUN_TIME_COUNTER_TYPE idle = (configRUN_TIME_COUNTER_TYPE)(ulTaskGetIdleRunTimeCounter() - run->idle);
+
+	cur->ms = sys_now() - run->start;
+	/* Bits per millisecond are kbit/s */
+	cur->kbps = (cur->ms != 0U) ? (u32_t)((cur->bytes * 8U) / cur->ms) : 0U;
+	cur->retransmits = IPERF_RETRANSMITS() - run->retransmits;
+	if ((total != 0U) && (idle < total)) {
+		cur->cpu_load = (u16_t)(10000U - ((uint64_t)idle * 10000U) / total);
+	}
+	cur->seq = s_report[test].seq + 1U;
+	s_report[test] = *cur;
+}
+
+static int run_done(enum iperf_test test, const struct iperf_limit *limit, u32_t bytes)
+{
+	if (limit->bytes != 0U) {
+		return bytes >= limit->bytes;
+	}
+	return (sys_now() - s_run[test].start) >= limit->ms;
+}
+
+static void limit_from_hdr(struct iperf_limit *limit, const struct iperf_client_hdr *hdr)
+{
+	s32_t amount = (s32_t)lwip_ntohl(hdr->amount);
+
+	limit->bytes = 0U;
+	limit->ms = IPERF_DEFAULT_MS;
+	if (amount < 0) {
+		limit->ms = (u32_t)-amount * 10U;
+	} else if (amount > 0) {
+		limit->bytes = (u32_t)amount;
+	}
+}
+
+/* TCP send test, connects to the client for dual and tradeoff tests */
+
+static err_t tcp_tx_close(struct tcp_pcb *pcb)
+{
+	s_tcp_tx = NULL;
+	run_end(IPERF_TCP_TX);
+
+	tcp_arg(pcb, NULL);
+	tcp_sent(pcb, NULL);
+	tcp_poll(pcb, NULL, 0U);
+	tcp_err(pcb, NULL);
+	if (tcp_close(pcb) != ERR_OK) {
+		tcp_abort(pcb);
+		return ERR_ABRT;
+	}
+	return ERR_OK;
+}
+
+static err_t tcp_tx_send(struct tcp_pcb *pcb)
+{
+	/* Byte limited tests end once the client acknowledged all bytes */
+	if (run_done(IPERF_TCP_TX, &s_tcp_tx_limit, (u32_t)s_run[IPERF_TCP_TX].cur.bytes)) {
+		return tcp_tx_close(pcb);
+	}
+
+	for ( ; ; ) {
+		u32_t len = LWIP_MIN(tcp_sndbuf(pcb), sizeof(s_tx_buf));
+
+		/* Nothing more is queued once the limit is, the sent callback
+		 * keeps coming until it is acknowledged */
+		if (s_tcp_tx_limit.bytes != 0U) {
+			len = LWIP_MIN(len, s_tcp_tx_limit.bytes - s_tcp_tx_queued);
+		}
+		/* Without TCP_WRITE_FLAG_COPY the segments reference s_tx_buf */
+		if ((len == 0U) || (tcp_write(pcb, s_tx_buf, (u16_t)len, TCP_WRITE_FLAG_MORE) != ERR_OK)) {
+			break;
+		}
+		s_tcp_tx_queued += len;
+	}
+	(void)tcp_output(pcb);
+
+	return ERR_OK;
+}
+
+static err_t tcp_tx_sent(void *arg, struct tcp_pcb *pcb, u16_t len)
+{
+	(void)arg;
+
+	s_run[IPERF_TCP_TX].cur.bytes += len;
+	return tcp_tx_send(pcb);
+}
+
+static err_t tcp_tx_poll(void *arg, struct tcp_pcb *pcb)
+{
+	(void)arg;
+
+	return tcp_tx_send(pcb);
+}
+
+static err_t tcp_tx_connected(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+	(void)arg;
+
+	if (err != ERR_OK) {
+		return tcp_tx_close(pcb);
+	}
+	run_begin(IPERF_TCP_TX);
+	return tcp_tx_send(pcb);
+}
+
+static void tcp_tx_err(void *arg, err_t err)
+{
+	(void)arg;
+	(void)err;
+
+	s_tcp_tx = NULL;
+	run_end(IPERF_TCP_TX);
+}
+
+static void tcp_tx_start(const ip_addr_t *addr, const struct iperf_client_hdr *hdr)
+{
+	if (s_tcp_tx != NULL) {
+		return;
+	}
+
+	struct tcp_pcb *pcb = tcp_new_ip_type(IP_GET_TYPE(addr));
+	if (pcb == NULL) {
+		return;
+	}
+
+	limit_from_hdr(&s_tcp_tx_limit, hdr);
+	s_tcp_tx_queued = 0U;
+	tcp_sent(pcb, tcp_tx_sent);
+	tcp_poll(pcb, tcp_tx_poll, 2U);
+	tcp_err(pcb, tcp_tx_err);
+	if (tcp_connect(pcb, addr, (u16_t)lwip_ntohl(hdr->port), tcp_tx_connected) != ERR_OK) {
+		tcp_abort(pcb);
+		return;
+	}
+	s_tcp_tx = pcb;
+}
+
+/* TCP receive test */
+
+static err_t tcp_rx_close(struct tcp_pcb *pcb)
+{
+	err_t err = ERR_OK;
+	ip_addr_t remote;
+
+	ip_addr_copy(remote, pcb->remote_ip);
+	s_tcp_rx = NULL;
+	run_end(IPERF_TCP_RX);
+
+	tcp_arg(pcb, NULL);
+	tcp_recv(pcb, NULL);
+	tcp_err(pcb, NULL);
+	if (tcp_close(pcb) != ERR_OK) {
+		tcp_abort(pcb);
+		err = ERR_ABRT;
+	}
+
+	/* Tradeoff test, send once the client finished sending */
+	if ((s_tcp_hdr_len == sizeof(s_tcp_hdr)) &&
+	    ((lwip_ntohl(s_tcp_hdr.flags) & (IPERF_HEADER_VERSION1 | IPERF_RUN_NOW)) == IPERF_HEADER_VERSION1)) {
+		tcp_tx_start(&remote, &s_tcp_hdr);
+	}
+	return err;
+}
+
+static err_t tcp_rx_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+	(void)arg;
+	(void)err;
+
+	if (p == NULL) {
+		return tcp_rx_close(pcb);
+	}
+
+	if (s_tcp_hdr_len < sizeof(s_tcp_hdr)) {
+		s_tcp_hdr_len += pbuf_copy_partial(p, (u8_t *)&s_tcp_hdr + s_tcp_hdr_len,
+						   (u16_t)(sizeof(s_tcp_hdr) - s_tcp_hdr_len), 0U);
+		/* Dual test, send while receiving */
+		if ((s_tcp_hdr_len == sizeof(s_tcp_hdr)) &&
+		    ((lwip_ntohl(s_tcp_hdr.flags) & (IPERF_HEADER_VERSION1 | IPERF_RUN_NOW)) ==
+		     (IPERF_HEADER_VERSION1 | IPERF_RUN_NOW))) {
+			tcp_tx_start(&pcb->remote_ip, &s_tcp_hdr);
+		}
+	}
+
+	s_run[IPERF_TCP_RX].cur.bytes += p->tot_len;
+	tcp_recved(pcb, p->tot_len);
+	pbuf_free(p);
+
+	return ERR_OK;
+}
+
+static void tcp_rx_err(void *arg, err_t err)
+{
+	(void)arg;
+	(void)err;
+
+	s_tcp_rx = NULL;
+	run_end(IPERF_TCP_RX);
+}
+
+static err_t tcp_rx_accept(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+	(void)arg;
+
+	if ((err != ERR_OK) || (pcb == NULL)) {
+		return ERR_VAL;
+	}
+	/* One receive test at a time */
+	if (s_tcp_rx != NULL) {
+		tcp_abort(pcb);
+		return ERR_ABRT;
+	}
+
+	s_tcp_rx = pcb;
+	s_tcp_hdr_len = 0U;
+	tcp_recv(pcb, tcp_rx_recv);
+	tcp_err(pcb, tcp_rx_err);
+	run_begin(IPERF_TCP_RX);
+
+	return ERR_OK;
+}
+
+/* UDP send test, paced in 1 ms steps */
+
+static err_t udp_tx_datagram(s32_t id)
+{
+	u32_t elapsed = sys_now() - s_run[IPERF_UDP_TX].start;
+	struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, (u16_t)sizeof(struct iperf_udp_hdr), PBUF_RAM);
+	struct pbuf *data = pbuf_alloc(PBUF_RAW, (u16_t)(s_udp_tx_len - sizeof(struct iperf_udp_hdr)), PBUF_REF);
+	err_t err = ERR_MEM;
+
+	if ((p != NULL) && (data != NULL)) {
+		struct iperf_udp_hdr *hdr = (struct iperf_udp_hdr *)p->payload;
+
+		hdr->id = lwip_htonl((u32_t)id);
+		hdr->tv_sec = lwip_htonl(elapsed / 1000U);
+		hdr->tv_usec = lwip_htonl((elapsed % 1000U) * 1000U);
+		data->payload = s_tx_buf;
+		pbuf_cat(p, data);
+		data = NULL;
+		err = udp_send(s_udp_tx, p);
+	}
+
+	if (data != NULL) {
+		pbuf_free(data);
+	}
+	if (p != NULL) {
+		pbuf_free(p);
+	}
+	return err;
+}
+
+static void udp_tx_tick(void *arg)
+{
+	(void)arg;
+	struct iperf_run *run = &s_run[IPERF_UDP_TX];
+
+	if (s_udp_tx_fin != 0U) {
+		/* The client has no final datagram if all of them are lost */
+		(void)udp_tx_datagram(-s_udp_tx_id);
+		if (--s_udp_tx_fin == 0U) {
+			udp_remove(s_udp_tx);
+			s_udp_tx = NULL;
+			return;
+		}
+		sys_timeout(10U, udp_tx_tick, NULL);
+		return;
+	}
+
+	if (run_done(IPERF_UDP_TX, &s_udp_tx_limit, (u32_t)run->cur.bytes)) {
+		run_end(IPERF_UDP_TX);
+		s_udp_tx_fin = IPERF_UDP_FIN_CNT;
+		sys_timeout(1U, udp_tx_tick, NULL);
+		return;
+	}
+
+	uint64_t due = ((uint64_t)s_udp_tx_rate * (sys_now() - run->start)) / 8000U;
+	while (run->cur.bytes < due) {
+		if (udp_tx_datagram(s_udp_tx_id) != ERR_OK) {
+			break;
+		}
+		s_udp_tx_id++;
+		run->cur.datagrams++;
+		run->cur.bytes += s_udp_tx_len;
+	}
+	sys_timeout(1U, udp_tx_tick, NULL);
+}
+
+static void udp_tx_start(const ip_addr_t *addr, const struct iperf_client_hdr *hdr)
+{
+	u32_t len = lwip_ntohl(hdr->buffer_len);
+
+	if (s_udp_tx != NULL) {
+		return;
+	}
+	s_udp_tx = udp_new_ip_type(IP_GET_TYPE(addr));
+	if (s_udp_tx == NULL) {
+		return;
+	}
+	if (udp_connect(s_udp_tx, addr, (u16_t)lwip_ntohl(hdr->port)) != ERR_OK) {
+		udp_remove(s_udp_tx);
+		s_udp_tx = NULL;
+		return;
+	}
+
+	limit_from_hdr(&s_udp_tx_limit, hdr);
+	s_udp_tx_rate = lwip_ntohl(hdr->win_band);
+	if (s_udp_tx_rate == 0U) {
+		s_udp_tx_rate = IPERF_DEFAULT_RATE;
+	}
+	if ((len < sizeof(struct iperf_udp_hdr)) || (len > sizeof(s_tx_buf))) {
+		len = sizeof(s_tx_buf);
+	}
+	s_udp_tx_len = (u16_t)len;
+	s_udp_tx_id = 0;
+	s_udp_tx_fin = 0U;
+
+	run_begin(IPERF_UDP_TX);
+	sys_timeout(1U, udp_tx_tick, NULL);
+}
+
+/* UDP receive test */
+
+static void udp_rx_reply(struct udp_pcb *pcb, const struct iperf_udp_hdr *fin,
+			 const ip_addr_t *addr, u16_t port)
+{
+	const struct iperf_report *report = &s_report[IPERF_UDP_RX];
+	struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT,
+				    (u16_t)(sizeof(struct iperf_udp_hdr) + sizeof(struct iperf_server_hdr)), PBUF_RAM);
+	if (p == NULL) {
+		return;
+	}
+
+	struct iperf_server_hdr *hdr = (struct iperf_server_hdr *)((u8_t *)p->payload + sizeof(*fin));
+	memcpy(p->payload, fin, sizeof(*fin));
+	hdr->flags = lwip_htonl(IPERF_HEADER_VERSION1);
+	hdr->total_len1 = lwip_htonl((u32_t)(report->bytes >> 32));
+	hdr->total_len2 = lwip_htonl((u32_t)report->bytes);
+	hdr->stop_sec = lwip_htonl(report->ms / 1000U);
+	hdr->stop_usec = lwip_htonl((report->ms % 1000U) * 1000U);
+	hdr->error_cnt = lwip_htonl(report->lost);
+	hdr->outorder_cnt = lwip_htonl(report->out_of_order);
+	hdr->datagrams = lwip_htonl(report->datagrams + report->lost);
+	hdr->jitter1 = lwip_htonl(report->jitter_us / 1000000U);
+	hdr->jitter2 = lwip_htonl(report->jitter_us % 1000000U);
+
+	(void)udp_sendto(pcb, p, addr, port);
+	pbuf_free(p);
+}
+
+/* RFC 1889 interarrival jitter of the transit time */
+static void udp_rx_jitter(const struct iperf_udp_hdr *hdr)
+{
+	u32_t sent = lwip_ntohl(hdr->tv_sec) * 1000U + lwip_ntohl(hdr->tv_usec) / 1000U;
+	s32_t transit = (s32_t)(sys_now() - sent);
+
+	if (s_run[IPERF_UDP_RX].cur.datagrams > 1U) {
+		s32_t d = transit - s_udp_last_transit;
+		u32_t d_us = (u32_t)((d < 0) ? -d : d) * 1000U;
+
+		s_udp_jitter_us = (u32_t)((s32_t)s_udp_jitter_us + ((s32_t)d_us - (s32_t)s_udp_jitter_us) / 16);
+	}
+	s_udp_last_transit = transit;
+}
+
+static void udp_rx_end(void)
+{
+	struct iperf_run *run = &s_run[IPERF_UDP_RX];
+
+	if (run->active) {
+		run->cur.jitter_us = s_udp_jitter_us;
+		run_end(IPERF_UDP_RX);
+	}
+}
+
+static void udp_rx_idle(void *arg)
+{
+	(void)arg;
+
+	udp_rx_end();
+	s_udp_tradeoff = 0U;
+}
+
+static void udp_rx_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p,
+			const ip_addr_t *addr, u16_t port)
+{
+	(void)arg;
+	struct iperf_run *run = &s_run[IPERF_UDP_RX];
+	struct iperf_udp_hdr hdr;
+
+	if (pbuf_copy_partial(p, &hdr, sizeof(hdr), 0U) != sizeof(hdr)) {
+		pbuf_free(p);
+		return;
+	}
+	s32_t id = (s32_t)lwip_ntohl(hdr.id);
+
+	if (id < 0) {
+		/* The client repeats the final datagram until it gets the report */
+		pbuf_free(p);
+		sys_untimeout(udp_rx_idle, NULL);
+		udp_rx_end();
+		udp_rx_reply(pcb, &hdr, addr, port);
+		if (s_udp_tradeoff) {
+			s_udp_tradeoff = 0U;
+			udp_tx_start(&s_udp_peer, &s_udp_hdr);
+		}
+		return;
+	}
+
+	/* A datagram of another client ends the unfinished test */
+	if (run->active && (!ip_addr_cmp(&s_udp_peer, addr) || (s_udp_peer_port != port))) {
+		udp_rx_end();
+	}
+	if (!run->active) {
+		run_begin(IPERF_UDP_RX);
+		s_udp_last_id = -1;
+		s_udp_jitter_us = 0U;
+		s_udp_tradeoff = 0U;
+		ip_addr_copy(s_udp_peer, *addr);
+		s_udp_peer_port = port;
+
+		if (pbuf_copy_partial(p, &s_udp_hdr, sizeof(s_udp_hdr), sizeof(hdr)) == sizeof(s_udp_hdr)) {
+			u32_t flags = lwip_ntohl(s_udp_hdr.flags);
+
+			if (flags & IPERF_HEADER_VERSION1) {
+				if (flags & IPERF_RUN_NOW) {
+					udp_tx_start(addr, &s_udp_hdr);
+				} else {
+					s_udp_tradeoff = 1U;
+				}
+			}
+		}
+	}
+
+	run->cur.datagrams++;
+	run->cur.bytes += p->tot_len;
+	if (id > s_udp_last_id + 1) {
+		run->cur.lost += (u32_t)(id - s_udp_last_id - 1);
+	} else if (id <= s_udp_last_id) {
+		run->cur.out_of_order++;
+		if (run->cur.lost != 0U) {
+			run->cur.lost--;
+		}
+	}
+	if (id > s_udp_last_id) {
+		s_udp_last_id = id;
+	}
+	udp_rx_jitter(&hdr);
+
+	pbuf_free(p);
+	sys_untimeout(udp_rx_idle, NULL);
+	sys_timeout(IPERF_UDP_IDLE_MS, udp_rx_idle, NULL);
+}
+
+/* Listens on IPERF_PORT for TCP and UDP tests. Must be called with the tcpip
+ * core locked. */
+void iperf_init(void)
+{
+	struct tcp_pcb *pcb = tcp_new_ip_type(IPADDR_TYPE_ANY);
+	LWIP_ASSERT("failed to allocate iperf pcb", pcb != NULL);
+
+	err_t err = tcp_bind(pcb, IP_ANY_TYPE, IPERF_PORT);
+	LWIP_ASSERT("failed to bind iperf pcb", err == ERR_OK);
+	(void)err;
+	pcb = tcp_listen_with_backlog(pcb, 1U);
+	LWIP_ASSERT("failed to listen on iperf pcb", pcb != NULL);
+	tcp_accept(pcb, tcp_rx_accept);
+
+	s_udp_rx = udp_new_ip_type(IPADDR_TYPE_ANY);
+	LWIP_ASSERT("failed to allocate iperf udp pcb", s_udp_rx != NULL);
+	(void)udp_bind(s_udp_rx, IP_ANY_TYPE, IPERF_PORT);
+	udp_recv(s_udp_rx, udp_rx_recv, NULL);
+}
+
+/* Copies the report of the last finished test. Must be called with the tcpip
+ * core locked. */
+void iperf_get_report(enum iperf_test test, struct iperf_report *report)
+{
+	*report = s_report[test];
+}
+
+#endif /* IPERF_PORT */
@@ -3,6 +3,11 @@
 
 #include "error_handler.h"
 #include "ethif.h"
+#include "iperf.h"
+#include "pcap.h"
+#include "ptp.h"
+#include "rtstats.h"
+#include "trace.h"
 
 #include "FreeRTOS.h"
 #include "task.h"
@@ -12,6 +17,25 @@
 #include "lwip/inet.h"
 
 
+/* TIM2 counter ticks per millisecond, see tim2_init() */
+#define TIM2_TICKS_PER_MS	100U
+
+/* Uninitialized data in CCM RAM. The ETH DMA has no access to it, so task
+ * stacks placed there must not hold buffers passed to lwIP by reference. */
+#define CCM_NOINIT		__attribute__((section(".ccm_noinit")))
+
+#if configSUPPORT_STATIC_ALLOCATION
+/* Each expansion gets its own stack in CCM RAM and TCB */
+#define TASK_CREATE(fn, name, depth, prio) do { \
+		static StackType_t stack[depth] CCM_NOINIT; \
+		static StaticTask_t tcb; \
+		(void)xTaskCreateStatic(fn, name, depth, NULL, prio, stack, &tcb); \
+	} while (0)
+#else
+#define TASK_CREATE(fn, name, depth, prio) \
+	(void)xTaskCreate(fn, name, depth, NULL, prio, NULL)
+#endif
+
 static RNG_HandleTypeDef rng_handle;
 
 static struct netif s_netif;
@@ -67,7 +91,18 @@ static void SystemClock_Config(void)
 
 volatile int g_link;
 volatile char *g_ip;
-volatile char *g_cpu;
+volatile struct ethif_rx_pool_stats g_rx_pool;
+volatile size_t g_heap_free;
+volatile size_t g_heap_min_free;
+#if LWIP_FREERTOS_SYS_ARCH_PROTECT_STATS
+volatile struct sys_arch_protect_stats g_protect;
+#endif
+#if IPERF_PORT
+volatile struct iperf_report g_iperf[IPERF_TEST_CNT];
+#endif
+#if ETHIF_PTP
+volatile struct ptp_stats g_ptp;
+#endif
 
 static void ethernet_link_updated(struct netif *netif)
 {
@@ -83,8 +118,8 @@ static void link_state(void *const arg)
 {
 	(void)arg;
 	for ( ; ; ) {
-		vTaskDelay(100);
-		enum link_status link = ethphy_getlink();
+		enum link_status link = ethphy_wait_link();
+		LOCK_TCPIP_CORE();
 		if (link == LINK_UP) {
 			netif_set_up(&s_netif);
 			netif_set_link_up(&s_netif);
@@ -94,30 +129,62 @@ static void link_state(void *const arg)
 		} else {
 			/* No action */
 		}
+		UNLOCK_TCPIP_CORE();
 	}
 }
 
 static void ethernetif_input(void *const arg)
 {
 	(void)arg;
-	struct pbuf *p = NULL;
 
 	for ( ; ; ) {
-		vTaskDelay(2);
-		do {
-			/* move received packet into a new pbuf */
-			p = low_level_input(&s_netif);
-			if (p != NULL) {
-				/* entry point to the LwIP stack */
-				err_t err = s_netif.input(p, &s_netif);
-				if (err != ERR_OK) {
-					pbuf_free(p);
-					p = NULL;
-				}
-			}
-		} while (p != NULL);
+		ethif_wait_rx();
+		/* pass received frames to the LwIP stack until the DMA is drained */
+		while (ethif_input_batch(&s_netif) == ETHIF_RX_BATCH) { }
+	}
+}
+
+#if ETHIF_PCAP
+/* ITM stimulus port the capture is streamed to over SWO */
+#define PCAP_ITM_PORT		1U
+
+/* Set by the debugger to replay a pcap file loaded into target memory */
+volatile const void *g_pcap_replay;
+volatile uint32_t g_pcap_replay_len;
+volatile uint32_t g_pcap_dropped;
+volatile uint32_t g_pcap_truncated;
+
+static void pcap_itm_write(const void *data, size_t len)
+{
+	const uint8_t *byte = data;
+
+	if (((ITM->TCR & ITM_TCR_ITMENA_Msk) == 0UL) || ((ITM->TER & (1UL << PCAP_ITM_PORT)) == 0UL)) {
+		return;
+	}
+
+	while (len-- > 0U) {
+		while (ITM->PORT[PCAP_ITM_PORT].u32 == 0UL) { }
+		ITM->PORT[PCAP_ITM_PORT].u8 = *byte++;
+	}
+}
+
+static void pcap_task(void *const arg)
+{
+	(void)arg;
+
+	for ( ; ; ) {
+		vTaskDelay(10);
+		(void)pcap_drain(pcap_itm_write);
+		g_pcap_dropped = pcap_dropped();
+
+		if (g_pcap_replay != NULL) {
+			(void)pcap_replay(&s_netif, (const void *)g_pcap_replay, g_pcap_replay_len, 1);
+			g_pcap_truncated = pcap_truncated();
+			g_pcap_replay = NULL;
+		}
 	}
 }
+#endif /* ETHIF_PCAP */
 
 static void led_init(void)
 {
@@ -156,6 +223,9 @@ static void init_task(void *arg)
 	ip_addr_set_zero_ip4(&s_ipaddr);
 	ip_addr_set_zero_ip4(&s_netmask);
 	ip_addr_set_zero_ip4(&s_gw);
+
+	/* The tcpip thread is running, raw API calls below need the core lock */
+	LOCK_TCPIP_CORE();
 	/* add the network interface (IPv4/IPv6) with RTOS */
 	/* The application must add the network interface to lwIP list of network interfaces (netifs
 	 in lwIP parlance) by calling netif_add(), which takes the interface initialization function */
@@ -178,29 +248,65 @@ static void init_task(void *arg)
 		/* When the netif link is down this function must be called */
 		netif_set_down(&s_netif);
 	}
+	UNLOCK_TCPIP_CORE();
 
-	xTaskCreate(link_state, "link_st", 128, NULL, 3, NULL);
-	xTaskCreate(ethernetif_input, "ethif_in", 128, NULL, 3, NULL);
+	TASK_CREATE(link_state, "link_st", 128, 3);
+	TASK_CREATE(ethernetif_input, "ethif_in", 128, 3);
+#if ETHIF_PCAP
+	TASK_CREATE(pcap_task, "pcap", 256, 2);
+#endif
 
 	/* Application can call dhcp_start() to start the DHCP negotiation */
 	/* Start DHCP negotiation for a network interface (IPv4) */
+	LOCK_TCPIP_CORE();
 	dhcp_start(&s_netif);
+#if RTSTATS_UDP_PORT
+	rtstats_udp_init();
+#endif
+#if IPERF_PORT
+	iperf_init();
+#endif
+#if ETHIF_PTP
+	ptp_init(&s_netif);
+#endif
+	UNLOCK_TCPIP_CORE();
 
 	for ( ; ; ) {
 		vTaskDelay(500);
 		led_toggle();
-
-		static char pcWriteBuffer[1024];
-		vTaskGetRunTimeStats((char *)&pcWriteBuffer[0]);
-		g_cpu = &pcWriteBuffer[0];
-		g_cpu[1023] = 0;
-
+		rtstats_update();
+
+		struct ethif_rx_pool_stats rx_pool;
+		ethif_get_rx_pool_stats(&rx_pool);
+		g_rx_pool = rx_pool;
+		g_heap_free = xPortGetFreeHeapSize();
+		g_heap_min_free = xPortGetMinimumEverFreeHeapSize();
+#if LWIP_FREERTOS_SYS_ARCH_PROTECT_STATS
+		struct sys_arch_protect_stats protect;
+		sys_arch_protect_get_stats(&protect);
+		g_protect = protect;
+#endif
+
+		LOCK_TCPIP_CORE();
 		if (dhcp_supplied_address(&s_netif)) {
 			static char str[128] = { 0 };
 			snprintf(str, sizeof(str), "%s", inet_ntoa(s_netif.ip_addr));
 			g_ip = &str[0];
 			g_ip[127] = 0;
 		}
+#if IPERF_PORT
+		for (uint32_t i = 0U; i < IPERF_TEST_CNT; i++) {
+			struct iperf_report iperf;
+			iperf_get_report((enum iperf_test)i, &iperf);
+			g_iperf[i] = iperf;
+		}
+#endif
+#if ETHIF_PTP
+		struct ptp_stats ptp;
+		ptp_get_stats(&ptp);
+		g_ptp = ptp;
+#endif
+		UNLOCK_TCPIP_CORE();
 	}
 }
 
@@ -213,11 +319,34 @@ int main()
 
 	/* Configure the system clock to 168MHz */
 	SystemClock_Config();
+	trace_init();
 
-	xTaskCreate(init_task, "init", 2048, NULL, 3, NULL);
+	TASK_CREATE(init_task, "init", 2048, 3);
 	vTaskStartScheduler();
 }
 
+#if configSUPPORT_STATIC_ALLOCATION
+void vApplicationGetIdleTaskMemory(StaticTask_t **tcb, StackType_t **stack, configSTACK_DEPTH_TYPE *depth)
+{
+	static StaticTask_t idle_tcb;
+	static StackType_t idle_stack[configMINIMAL_STACK_SIZE] CCM_NOINIT;
+
+	*tcb = &idle_tcb;
+	*stack = &idle_stack[0];
+	*depth = configMINIMAL_STACK_SIZE;
+}
+
+void vApplicationGetTimerTaskMemory(StaticTask_t **tcb, StackType_t **stack, configSTACK_DEPTH_TYPE *depth)
+{
+	static StaticTask_t timer_tcb;
+	static StackType_t timer_stack[configTIMER_TASK_STACK_DEPTH] CCM_NOINIT;
+
+	*tcb = &timer_tcb;
+	*stack = &timer_stack[0];
+	*depth = configTIMER_TASK_STACK_DEPTH;
+}
+#endif /* configSUPPORT_STATIC_ALLOCATION */
+
 uint32_t HAL_GetTick(void)
 {
 	return xTaskGetTickCount();
@@ -247,3 +376,59 @@ uint32_t tim2_cnt(void)
 {
 	return TIM2->CNT;
 }
+
+#if RUN_TIME_STATS_DWT
+void dwt_init(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	__asm volatile ("dmb" : : : "memory");
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/* CYCCNT wraps every 25.6 s at 168 MHz. The kernel reads the counter on every
+ * context switch and rtstats_update() reads it every 500 ms, so no wrap is
+ * missed. Called from PendSV as well as from tasks. */
+uint64_t dwt_cnt64(void)
+{
+	static uint32_t last;
+	static uint32_t high;
+	uint64_t ret;
+
+	UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+	uint32_t cnt = DWT->CYCCNT;
+	if (cnt < last) {
+		high++;
+	}
+	last = cnt;
+	ret = ((uint64_t)high << 32) | cnt;
+	taskEXIT_CRITICAL_FROM_ISR(mask);
+
+	return ret;
+}
+#endif /* RUN_TIME_STATS_DWT */
+
+/* lwIP time base. TIM2 is folded into a millisecond count on every call, so
+ * the result wraps at 2^32 ms as lwIP expects, provided sys_now() is called
+ * at least once per TIM2 period (~11.9 h). The lwIP timers keep it busy. */
+u32_t sys_now(void)
+{
+	static uint32_t last_cnt;
+	static uint32_t frac;
+	static u32_t now_ms;
+	u32_t ret;
+
+	UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+	uint32_t cnt = tim2_cnt();
+	uint32_t ticks = cnt - last_cnt;
+	last_cnt = cnt;
+	/* Split before adding the remainder, so a gap of up to a full TIM2
+	 * period does not overflow */
+	now_ms += ticks / TIM2_TICKS_PER_MS;
+	frac += ticks % TIM2_TICKS_PER_MS;
+	now_ms += frac / TIM2_TICKS_PER_MS;
+	frac %= TIM2_TICKS_PER_MS;
+	ret = now_ms;
+	taskEXIT_CRITICAL_FROM_ISR(mask);
+
+	return ret;
+}
@@ -0,0 +1,255 @@
+#include <string.h>
+
+#include "lwip/sys.h"
+
+#include "stm32f4xx_hal.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "ethif.h"
+#include "pcap.h"
+
+#if ETHIF_PCAP
+
+#if (PCAP_RING_SIZE & (PCAP_RING_SIZE - 1U)) != 0U
+#error "PCAP_RING_SIZE must be a power of two"
+#endif
+
+#define PCAP_MAGIC				0xA1B2C3D4UL
+#define PCAP_VERSION_MAJOR			2U
+#define PCAP_VERSION_MINOR			4U
+#define PCAP_SNAPLEN				65535UL
+#define PCAP_LINKTYPE_ETHERNET			1UL
+
+struct pcap_file_hdr {
+	uint32_t magic;
+	uint16_t version_major;
+	uint16_t version_minor;
+	int32_t thiszone;
+	uint32_t sigfigs;
+	uint32_t snaplen;
+	uint32_t network;
+};
+
+struct pcap_rec_hdr {
+	uint32_t ts_sec;
+	uint32_t ts_usec;
+	uint32_t incl_len;
+	uint32_t orig_len;
+};
+
+/* RX frames are referenced, not copied: p holds a reference to the pool
+ * buffer until pcap_drain() has written it. The stack moves payload and len
+ * of the first pbuf while it processes the frame, so they are sampled at
+ * capture time. Frames the stack rewrites in place, like ICMP echo requests
+ * answered in the same buffer, are written as modified if pcap_drain() comes
+ * later. TX frames are copied, p is NULL. */
+struct pcap_rec {
+	struct pbuf *p;
+	const void *payload;
+	uint16_t len;
+	uint16_t tot_len;
+	uint32_t ts_ms;
+};
+
+/* Single producer, single consumer ring: head is only written by the
+ * capturing task, tail only by pcap_drain() */
+struct pcap_ring {
+	struct pcap_rec rec[PCAP_RING_SIZE];
+	volatile uint32_t head;
+	volatile uint32_t tail;
+	volatile uint32_t dropped;
+};
+
+/* RX frames are captured by the ethernet input task and TX frames by the
+ * tcpip thread, so each direction gets its own ring */
+static struct pcap_ring s_ring[2];
+static int s_hdr_written;
+static uint32_t s_replay_truncated;
+
+/* Copies of the TX frames. A sent frame keeps its pbuf referenced until it is
+ * written, and lwIP does not retransmit a TCP segment in that state. */
+static uint8_t s_tx_data[PCAP_RING_SIZE][ETH_MAX_PACKET_SIZE];
+
+void pcap_tap(enum pcap_dir dir, struct pbuf *p)
+{
+	struct pcap_ring *ring = &s_ring[dir];
+	uint32_t head = ring->head;
+
+	if ((head - ring->tail) >= PCAP_RING_SIZE) {
+		ring->dropped++;
+		return;
+	}
+
+	uint32_t slot = head & (PCAP_RING_SIZE - 1U);
+	struct pcap_rec *rec = &ring->rec[slot];
+	if (dir == PCAP_RX) {
+		pbuf_ref(p);
+		rec->p = p;
+		rec->payload = p->payload;
+		rec->len = p->len;
+	} else {
+		rec->p = NULL;
+		rec->payload = s_tx_data[slot];
+		rec->len = pbuf_copy_partial(p, s_tx_data[slot], sizeof(s_tx_data[slot]), 0U);
+	}
+	rec->tot_len = p->tot_len;
+	rec->ts_ms = sys_now();
+
+	__asm volatile ("dmb" : : : "memory");
+	ring->head = head + 1U;
+}
+
+/* Returns the ring holding the oldest pending frame */
+static struct pcap_ring *pcap_oldest(void)
+{
+	struct pcap_ring *oldest = NULL;
+
+	for (size_t i = 0; i < (sizeof(s_ring) / sizeof(s_ring[0])); i++) {
+		struct pcap_ring *ring = &s_ring[i];
+		if (ring->head == ring->tail) {
+			continue;
+		}
+		__asm volatile ("dmb" : : : "memory");
+
+		if (oldest == NULL) {
+			oldest = ring;
+		} else {
+			uint32_t ts = ring->rec[ring->tail & (PCAP_RING_SIZE - 1U)].ts_ms;
+			uint32_t ts_oldest = oldest->rec[oldest->tail & (PCAP_RING_SIZE - 1U)].ts_ms;
+			if ((int32_t)(ts - ts_oldest) < 0) {
+				oldest = ring;
+			}
+		}
+	}
+
+	return oldest;
+}
+
+static void pcap_write_rec(pcap_write_fn write, const struct pcap_rec *rec)
+{
+	struct pcap_rec_hdr hdr;
+	hdr.ts_sec = rec->ts_ms / 1000U;
+	hdr.ts_usec = (rec->ts_ms % 1000U) * 1000U;
+	hdr.orig_len = rec->tot_len;
+	hdr.incl_len = rec->len;
+	if (rec->p != NULL) {
+		hdr.incl_len = rec->tot_len;
+	}
+	write(&hdr, sizeof(hdr));
+
+	write(rec->payload, rec->len);
+	if (rec->p == NULL) {
+		return;
+	}
+	uint16_t left = (uint16_t)(rec->tot_len - rec->len);
+	for (const struct pbuf *q = rec->p->next; (q != NULL) && (left > 0U); q = q->next) {
+		uint16_t len = (q->len < left) ? q->len : left;
+		write(q->payload, len);
+		left = (uint16_t)(left - len);
+	}
+}
+
+size_t pcap_drain(pcap_write_fn write)
+{
+	size_t cnt = 0;
+
+	if (!s_hdr_written) {
+		struct pcap_file_hdr hdr;
+		hdr.magic = PCAP_MAGIC;
+		hdr.version_major = PCAP_VERSION_MAJOR;
+		hdr.version_minor = PCAP_VERSION_MINOR;
+		hdr.thiszone = 0;
+		hdr.sigfigs = 0;
+		hdr.snaplen = PCAP_SNAPLEN;
+		hdr.network = PCAP_LINKTYPE_ETHERNET;
+		write(&hdr, sizeof(hdr));
+		s_hdr_written = 1;
+	}
+
+	for (struct pcap_ring *ring = pcap_oldest(); ring != NULL; ring = pcap_oldest()) {
+		uint32_t tail = ring->tail;
+		struct pcap_rec *rec = &ring->rec[tail & (PCAP_RING_SIZE - 1U)];
+
+		pcap_write_rec(write, rec);
+		if (rec->p != NULL) {
+			pbuf_free(rec->p);
+		}
+
+		__asm volatile ("dmb" : : : "memory");
+		ring->tail = tail + 1U;
+		cnt++;
+	}
+
+	return cnt;
+}
+
+uint32_t pcap_dropped(void)
+{
+	return s_ring[PCAP_RX].dropped + s_ring[PCAP_TX].dropped;
+}
+
+uint32_t pcap_truncated(void)
+{
+	return s_replay_truncated;
+}
+
+/* Feeds the frames of an in-memory pcap file to netif->input.
+ * The frames are copied into RX pool buffers, so pool exhaustion behaves as
+ * with real traffic. With realtime set the inter-frame gaps of the capture are
+ * reproduced with tick resolution, otherwise frames are injected back-to-back.
+ * Records shorter than the frame they were captured from are skipped and
+ * counted by pcap_truncated(), the stack would drop them as short. */
+err_t pcap_replay(struct netif *netif, const void *file, size_t len, int realtime)
+{
+	const uint8_t *pos = file;
+	const uint8_t *end = pos + len;
+	struct pcap_file_hdr hdr;
+	struct pcap_rec_hdr rec;
+	TickType_t wake = xTaskGetTickCount();
+	uint32_t prev_ms = 0;
+	int first = 1;
+
+	if (len < sizeof(hdr)) {
+		return ERR_ARG;
+	}
+	memcpy(&hdr, pos, sizeof(hdr));
+	if ((hdr.magic != PCAP_MAGIC) || (hdr.network != PCAP_LINKTYPE_ETHERNET)) {
+		return ERR_VAL;
+	}
+	pos += sizeof(hdr);
+
+	while ((size_t)(end - pos) >= sizeof(rec)) {
+		memcpy(&rec, pos, sizeof(rec));
+		pos += sizeof(rec);
+		if (rec.incl_len > (size_t)(end - pos)) {
+			return ERR_VAL;
+		}
+
+		if (realtime) {
+			uint32_t ts_ms = rec.ts_sec * 1000U + rec.ts_usec / 1000U;
+			if (!first && ((int32_t)(ts_ms - prev_ms) > 0)) {
+				vTaskDelayUntil(&wake, pdMS_TO_TICKS(ts_ms - prev_ms));
+			}
+			prev_ms = ts_ms;
+			first = 0;
+		}
+
+		struct pbuf *p = NULL;
+		if (rec.incl_len < rec.orig_len) {
+			s_replay_truncated++;
+		} else if (rec.incl_len <= UINT16_MAX) {
+			p = ethif_rx_pbuf(pos, (uint16_t)rec.incl_len);
+		}
+		if (p != NULL) {
+			if (netif->input(p, netif) != ERR_OK) {
+				pbuf_free(p);
+			}
+		}
+		pos += rec.incl_len;
+	}
+
+	return ERR_OK;
+}
+
+#endif /* ETHIF_PCAP */
@@ -0,0 +1,368 @@
+#include <string.h>
+
+#include "lwip/igmp.h"
+#include "lwip/pbuf.h"
+#include "lwip/timeouts.h"
+#include "lwip/udp.h"
+
+#include "ethif.h"
+#include "ptp.h"
+
+#if ETHIF_PTP
+
+/* Minimal IEEE 1588-2008 ordinary clock, slave only, end-to-end delay
+ * mechanism over UDP/IPv4. It follows the first master it hears a Sync from,
+ * there is no best master clock algorithm. Everything runs in the tcpip
+ * thread: the receive callbacks, the Delay_Req timer, and the TX timestamps
+ * reported by the driver from HAL_ETH_ReleaseTxPacket().
+ *
+ * Offsets are computed from the hardware timestamps of the MAC:
+ *   t1 Sync sent by the master, from the Sync or its Follow_Up
+ *   t2 Sync received by us
+ *   t3 Delay_Req sent by us
+ *   t4 Delay_Req received by the master, from the Delay_Resp
+ * path delay = ((t2 - t1) + (t4 - t3)) / 2, offset = t2 - t1 - path delay
+ */
+
+#define PTP_MSG_SYNC				0x0U
+#define PTP_MSG_DELAY_REQ			0x1U
+#define PTP_MSG_FOLLOW_UP			0x8U
+#define PTP_MSG_DELAY_RESP			0x9U
+
+#define PTP_VERSION				2U
+#define PTP_FLAG_TWO_STEP			0x02U	/* flagField[0] */
+#define PTP_CONTROL_DELAY_REQ			1U
+#define PTP_LOG_INTERVAL_NONE			0x7FU
+
+/* Common message header */
+#define PTP_OFF_TYPE				0U
+#define PTP_OFF_VERSION				1U
+#define PTP_OFF_LENGTH				2U
+#define PTP_OFF_DOMAIN				4U
+#define PTP_OFF_FLAGS				6U
+#define PTP_OFF_CORRECTION			8U
+#define PTP_OFF_SOURCE				20U
+#define PTP_OFF_SEQ				30U
+#define PTP_OFF_CONTROL				32U
+#define PTP_OFF_INTERVAL			33U
+#define PTP_HDR_LEN				34U
+/* Timestamp of Sync, Delay_Req, Follow_Up and Delay_Resp */
+#define PTP_OFF_TIMESTAMP			PTP_HDR_LEN
+#define PTP_TIMESTAMP_LEN			10U
+/* requestingPortIdentity of Delay_Resp */
+#define PTP_OFF_REQUESTER			(PTP_OFF_TIMESTAMP + PTP_TIMESTAMP_LEN)
+
+#define PTP_PORT_ID_LEN				10U
+#define PTP_EVENT_MSG_LEN			(PTP_HDR_LEN + PTP_TIMESTAMP_LEN)
+#define PTP_DELAY_RESP_LEN			(PTP_OFF_REQUESTER + PTP_PORT_ID_LEN)
+
+#define NSEC_PER_SEC				1000000000LL
+
+static struct udp_pcb *s_event;
+static struct udp_pcb *s_general;
+static ip4_addr_t s_group;
+static u8_t s_port_id[PTP_PORT_ID_LEN];
+static u8_t s_have_master;
+
+/* Sync waiting for its Follow_Up */
+static u16_t s_sync_seq;
+static u8_t s_sync_wait;
+static int64_t s_t2;
+static int64_t s_sync_corr;
+/* t2 - t1 of the last complete Sync */
+static int64_t s_ms_diff;
+static u8_t s_ms_valid;
+
+static u16_t s_delay_seq;
+static int64_t s_t3;
+static u8_t s_t3_valid;
+static int64_t s_path_delay;
+
+static int64_t s_integral;
+static struct ptp_stats s_stats;
+
+static u16_t get_be16(const u8_t *b)
+{
+	return (u16_t)((b[0] << 8) | b[1]);
+}
+
+static u32_t get_be32(const u8_t *b)
+{
+	return ((u32_t)b[0] << 24) | ((u32_t)b[1] << 16) | ((u32_t)b[2] << 8) | b[3];
+}
+
+static void put_be16(u8_t *b, u16_t v)
+{
+	b[0] = (u8_t)(v >> 8);
+	b[1] = (u8_t)v;
+}
+
+/* 48-bit seconds and 32-bit nanoseconds, to ns */
+static int64_t get_timestamp(const u8_t *b)
+{
+	uint64_t sec = ((uint64_t)get_be16(b) << 32) | get_be32(b + 2);
+	return (int64_t)sec * NSEC_PER_SEC + (int64_t)get_be32(b + 6);
+}
+
+/* correctionField is in ns multiplied by 2^16 */
+static int64_t get_correction(const u8_t *b)
+{
+	uint64_t v = ((uint64_t)get_be32(b) << 32) | get_be32(b + 4);
+	return (int64_t)v / 65536;
+}
+
+static int64_t time_ns(const struct ethptp_time *ts)
+{
+	return (int64_t)ts->sec * NSEC_PER_SEC + (int64_t)ts->nsec;
+}
+
+static s32_t clamp_s32(int64_t v, s32_t limit)
+{
+	if (v > limit) {
+		return limit;
+	}
+	if (v < -limit) {
+		return -limit;
+	}
+	return (s32_t)v;
+}
+
+static void servo(int64_t offset)
+{
+	s_stats.offset_ns = clamp_s32(offset, INT32_MAX);
+
+	if ((offset > PTP_STEP_THRESHOLD_NS) || (offset < -PTP_STEP_THRESHOLD_NS)) {
+		if (ethptp_adjust_offset(-offset) != HAL_OK) {
+			/* The clock was not stepped, retry on the next Sync */
+			s_stats.errors++;
+			return;
+		}
+		s_stats.steps++;
+		s_integral = 0;
+		/* Timestamps taken before the step are no longer comparable */
+		s_ms_valid = 0U;
+		s_t3_valid = 0U;
+		return;
+	}
+
+	/* Slow the clock down while it is ahead of the master */
+	s_integral += offset;
+	int64_t limit = (int64_t)ETHPTP_MAX_PPB * 10 / PTP_SERVO_KI;
+	if (s_integral > limit) {
+		s_integral = limit;
+	} else if (s_integral < -limit) {
+		s_integral = -limit;
+	}
+	int64_t ppb = -(offset * PTP_SERVO_KP + s_integral * PTP_SERVO_KI) / 10;
+
+	s32_t freq = clamp_s32(ppb, ETHPTP_MAX_PPB);
+	if (ethptp_adjust_freq(freq) != HAL_OK) {
+		s_stats.errors++;
+		return;
+	}
+	s_stats.freq_ppb = freq;
+}
+
+static void sync_complete(int64_t t1)
+{
+	s_ms_diff = s_t2 - t1 - s_sync_corr;
+	s_ms_valid = 1U;
+	s_stats.syncs++;
+	servo(s_ms_diff - s_path_delay);
+}
+
+static int from_master(const u8_t *msg)
+{
+	if (!s_have_master) {
+		return 0;
+	}
+	return memcmp(&msg[PTP_OFF_SOURCE], s_stats.master, PTP_PORT_ID_LEN) == 0;
+}
+
+static void rx_sync(const u8_t *msg, u16_t len, int64_t t2)
+{
+	if (!s_have_master) {
+		memcpy(s_stats.master, &msg[PTP_OFF_SOURCE], PTP_PORT_ID_LEN);
+		s_have_master = 1U;
+	} else if (!from_master(msg)) {
+		return;
+	}
+
+	s_sync_seq = get_be16(&msg[PTP_OFF_SEQ]);
+	s_t2 = t2;
+	s_sync_corr = get_correction(&msg[PTP_OFF_CORRECTION]);
+	s_sync_wait = (msg[PTP_OFF_FLAGS] & PTP_FLAG_TWO_STEP) != 0U;
+	if (!s_sync_wait && (len >= PTP_EVENT_MSG_LEN)) {
+		sync_complete(get_timestamp(&msg[PTP_OFF_TIMESTAMP]));
+	}
+}
+
+static void rx_follow_up(const u8_t *msg, u16_t len)
+{
+	if (!s_sync_wait || !from_master(msg) || (len < PTP_EVENT_MSG_LEN) ||
+	    (get_be16(&msg[PTP_OFF_SEQ]) != s_sync_seq)) {
+		return;
+	}
+
+	s_sync_wait = 0U;
+	s_sync_corr += get_correction(&msg[PTP_OFF_CORRECTION]);
+	sync_complete(get_timestamp(&msg[PTP_OFF_TIMESTAMP]));
+}
+
+static void rx_delay_resp(const u8_t *msg, u16_t len)
+{
+	if (!s_t3_valid || !from_master(msg) || (len < PTP_DELAY_RESP_LEN) ||
+	    (get_be16(&msg[PTP_OFF_SEQ]) != s_delay_seq) ||
+	    (memcmp(&msg[PTP_OFF_REQUESTER], s_port_id, PTP_PORT_ID_LEN) != 0)) {
+		return;
+	}
+
+	s_t3_valid = 0U;
+	int64_t t4 = get_timestamp(&msg[PTP_OFF_TIMESTAMP]);
+	int64_t sm_diff = t4 - s_t3 - get_correction(&msg[PTP_OFF_CORRECTION]);
+	s_stats.delay_resps++;
+	if (s_ms_valid) {
+		s_path_delay = (s_ms_diff + sm_diff) / 2;
+		s_stats.path_delay_ns = clamp_s32(s_path_delay, INT32_MAX);
+	}
+}
+
+/* Copies the header and body of a message for this domain, returns its length
+ * or 0 if it is not one */
+static u16_t rx_copy(const struct pbuf *p, u8_t *msg, u16_t size)
+{
+	u16_t len = pbuf_copy_partial(p, msg, size, 0U);
+
+	if ((len < PTP_HDR_LEN) || ((msg[PTP_OFF_VERSION] & 0x0FU) != PTP_VERSION) ||
+	    (msg[PTP_OFF_DOMAIN] != PTP_DOMAIN)) {
+		return 0U;
+	}
+	return len;
+}
+
+static void event_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+	(void)arg;
+	(void)pcb;
+	(void)addr;
+	(void)port;
+	u8_t msg[PTP_EVENT_MSG_LEN];
+	struct ethptp_time ts;
+
+	u16_t len = rx_copy(p, msg, sizeof(msg));
+	if ((len != 0U) && ((msg[PTP_OFF_TYPE] & 0x0FU) == PTP_MSG_SYNC) && ethif_rx_timestamp(p, &ts)) {
+		rx_sync(msg, len, time_ns(&ts));
+	}
+	pbuf_free(p);
+}
+
+static void general_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+	(void)arg;
+	(void)pcb;
+	(void)addr;
+	(void)port;
+	u8_t msg[PTP_DELAY_RESP_LEN];
+
+	u16_t len = rx_copy(p, msg, sizeof(msg));
+	if (len != 0U) {
+		switch (msg[PTP_OFF_TYPE] & 0x0FU) {
+		case PTP_MSG_FOLLOW_UP:
+			rx_follow_up(msg, len);
+			break;
+		case PTP_MSG_DELAY_RESP:
+			rx_delay_resp(msg, len);
+			break;
+		default:
+			break;
+		}
+	}
+	pbuf_free(p);
+}
+
+static void delay_req_tick(void *arg)
+{
+	(void)arg;
+
+	sys_timeout(PTP_DELAY_REQ_INTERVAL_MS, delay_req_tick, NULL);
+	if (!s_have_master) {
+		return;
+	}
+
+	struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, PTP_EVENT_MSG_LEN, PBUF_RAM);
+	if (p == NULL) {
+		return;
+	}
+
+	/* originTimestamp is left 0, t3 is taken by the MAC */
+	u8_t *msg = (u8_t *)p->payload;
+	memset(msg, 0, PTP_EVENT_MSG_LEN);
+	msg[PTP_OFF_TYPE] = PTP_MSG_DELAY_REQ;
+	msg[PTP_OFF_VERSION] = PTP_VERSION;
+	put_be16(&msg[PTP_OFF_LENGTH], PTP_EVENT_MSG_LEN);
+	msg[PTP_OFF_DOMAIN] = PTP_DOMAIN;
+	memcpy(&msg[PTP_OFF_SOURCE], s_port_id, PTP_PORT_ID_LEN);
+	put_be16(&msg[PTP_OFF_SEQ], ++s_delay_seq);
+	msg[PTP_OFF_CONTROL] = PTP_CONTROL_DELAY_REQ;
+	msg[PTP_OFF_INTERVAL] = PTP_LOG_INTERVAL_NONE;
+
+	s_t3_valid = 0U;
+	ip_addr_t group;
+	ip_addr_copy_from_ip4(group, s_group);
+	(void)udp_sendto(s_event, p, &group, PTP_EVENT_PORT);
+	pbuf_free(p);
+}
+
+/* Called by the driver with the TX timestamp of a PTP event frame. offset is
+ * where the PTP message starts in p. */
+void ptp_tx_timestamp(const struct pbuf *p, uint16_t offset, const struct ethptp_time *ts)
+{
+	u8_t msg[PTP_HDR_LEN];
+
+	if ((pbuf_copy_partial(p, msg, sizeof(msg), offset) != sizeof(msg)) ||
+	    ((msg[PTP_OFF_TYPE] & 0x0FU) != PTP_MSG_DELAY_REQ) ||
+	    (get_be16(&msg[PTP_OFF_SEQ]) != s_delay_seq) ||
+	    (memcmp(&msg[PTP_OFF_SOURCE], s_port_id, PTP_PORT_ID_LEN) != 0)) {
+		return;
+	}
+
+	s_t3 = time_ns(ts);
+	s_t3_valid = 1U;
+}
+
+/* Joins the PTP multicast group and starts following a master.
+ * Must be called with the tcpip core locked. */
+void ptp_init(struct netif *netif)
+{
+	/* clockIdentity is the EUI-64 derived from the MAC address, port 1 */
+	s_port_id[0] = netif->hwaddr[0];
+	s_port_id[1] = netif->hwaddr[1];
+	s_port_id[2] = netif->hwaddr[2];
+	s_port_id[3] = 0xFFU;
+	s_port_id[4] = 0xFEU;
+	s_port_id[5] = netif->hwaddr[3];
+	s_port_id[6] = netif->hwaddr[4];
+	s_port_id[7] = netif->hwaddr[5];
+	put_be16(&s_port_id[8], 1U);
+
+	IP4_ADDR(&s_group, 224, 0, 1, 129);
+	(void)igmp_joingroup_netif(netif, &s_group);
+
+	s_event = udp_new_ip_type(IPADDR_TYPE_V4);
+	s_general = udp_new_ip_type(IPADDR_TYPE_V4);
+	LWIP_ASSERT("PTP pcbs", (s_event != NULL) && (s_general != NULL));
+	(void)udp_bind(s_event, IP4_ADDR_ANY, PTP_EVENT_PORT);
+	(void)udp_bind(s_general, IP4_ADDR_ANY, PTP_GENERAL_PORT);
+	udp_recv(s_event, event_recv, NULL);
+	udp_recv(s_general, general_recv, NULL);
+
+	sys_timeout(PTP_DELAY_REQ_INTERVAL_MS, delay_req_tick, NULL);
+}
+
+/* Must be called with the tcpip core locked */
+void ptp_get_stats(struct ptp_stats *stats)
+{
+	*stats = s_stats;
+}
+
+#endif /* ETHIF_PTP */
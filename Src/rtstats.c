@@ -0,0 +1,115 @@
+#include <string.h>
+
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "rtstats.h"
+
+/* rtstats_update() fills the snapshot that is not published in g_rtstats
+ * and then publishes it. seq is 0 while a snapshot is being written, so a
+ * reader can detect that it copied a snapshot under modification. */
+static struct rtstats s_stats[2];
+static TaskStatus_t s_status[RTSTATS_MAX_TASKS];
+static configRUN_TIME_COUNTER_TYPE s_total;
+
+const struct rtstats *volatile g_rtstats = &s_stats[0];
+
+static uint64_t prev_runtime(const struct rtstats *prev, uint32_t number)
+{
+	for (uint32_t i = 0U; i < prev->count; i++) {
+		if (prev->task[i].number == number) {
+			return prev->task[i].runtime;
+		}
+	}
+
+	/* New task, all of its run time falls into this interval */
+	return 0U;
+}
+
+/* Takes a snapshot of all tasks. uxTaskGetSystemState() returns no task at
+ * all if there are more than RTSTATS_MAX_TASKS. */
+void rtstats_update(void)
+{
+	const struct rtstats *prev = g_rtstats;
+	struct rtstats *next = (prev == &s_stats[0]) ? &s_stats[1] : &s_stats[0];
+	configRUN_TIME_COUNTER_TYPE total = 0U;
+	uint32_t seq = prev->seq + 1U;
+
+	next->seq = 0U;
+	__asm volatile ("dmb" : : : "memory");
+
+	UBaseType_t cnt = uxTaskGetSystemState(s_status, RTSTATS_MAX_TASKS, &total);
+	next->interval = (configRUN_TIME_COUNTER_TYPE)(total - s_total);
+	next->count = (uint32_t)cnt;
+	s_total = total;
+
+	for (uint32_t i = 0U; i < next->count; i++) {
+		const TaskStatus_t *status = &s_status[i];
+		struct rtstats_task *task = &next->task[i];
+		uint32_t number = (uint32_t)status->xTaskNumber;
+		/* In the counter width, so a wrapping 32-bit counter still gives the delta */
+		uint64_t delta = (configRUN_TIME_COUNTER_TYPE)(status->ulRunTimeCounter -
+			(configRUN_TIME_COUNTER_TYPE)prev_runtime(prev, number));
+		uint64_t load = 0U;
+
+		if (next->interval != 0U) {
+			load = (delta * 10000U) / next->interval;
+		}
+
+		strncpy(task->name, status->pcTaskName, sizeof(task->name));
+		task->number = number;
+		task->runtime = status->ulRunTimeCounter;
+		task->load = (uint16_t)((load > 10000U) ? 10000U : load);
+		task->stack_free = (uint16_t)status->usStackHighWaterMark;
+		task->prio = (uint8_t)status->uxCurrentPriority;
+		task->state = (uint8_t)status->eCurrentState;
+	}
+
+	__asm volatile ("dmb" : : : "memory");
+	next->seq = (seq != 0U) ? seq : 1U;
+	__asm volatile ("dmb" : : : "memory");
+	g_rtstats = next;
+}
+
+#if RTSTATS_UDP_PORT
+static void rtstats_udp_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p,
+			     const ip_addr_t *addr, u16_t port)
+{
+	(void)arg;
+	const struct rtstats *stats = NULL;
+	uint32_t seq = 0U;
+
+	pbuf_free(p);
+
+	struct pbuf *q = pbuf_alloc(PBUF_TRANSPORT, (u16_t)sizeof(struct rtstats), PBUF_RAM);
+	if (q == NULL) {
+		return;
+	}
+
+	/* Retry if the snapshot was rewritten while copying it */
+	do {
+		stats = g_rtstats;
+		seq = stats->seq;
+		__asm volatile ("dmb" : : : "memory");
+		memcpy(q->payload, stats, sizeof(struct rtstats));
+		__asm volatile ("dmb" : : : "memory");
+	} while ((seq == 0U) || (stats->seq != seq));
+
+	(void)udp_sendto(pcb, q, addr, port);
+	pbuf_free(q);
+}
+
+/* Answers every datagram on RTSTATS_UDP_PORT with the latest struct rtstats,
+ * in target byte order. Must be called with the tcpip core locked. */
+void rtstats_udp_init(void)
+{
+	struct udp_pcb *pcb = udp_new();
+	LWIP_ASSERT("failed to allocate rtstats pcb", pcb != NULL);
+
+	(void)udp_bind(pcb, IP_ANY_TYPE, RTSTATS_UDP_PORT);
+	udp_recv(pcb, rtstats_udp_recv, NULL);
+}
+#endif /* RTSTATS_UDP_PORT */
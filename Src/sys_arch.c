@@ -35,11 +35,14 @@
 #include "lwip/def.h"
 #include "lwip/sys.h"
 #include "lwip/mem.h"
+#include "lwip/memp.h"
 #include "lwip/stats.h"
 #include "lwip/err.h"
+#include "lwip/tcpip.h"
 #include "FreeRTOS.h"
 #include "semphr.h"
 #include "task.h"
+#include "trace.h"
 
 /** Set this to 1 if you want the stack size passed to sys_thread_new() to be
  * interpreted as number of stack words (FreeRTOS-like).
@@ -56,6 +59,32 @@
 #define LWIP_FREERTOS_SYS_ARCH_PROTECT_USES_MUTEX     0
 #endif
 
+/** Set this to 1 to implement SYS_ARCH_PROTECT() by raising BASEPRI to
+ * LWIP_FREERTOS_SYS_ARCH_PROTECT_PRIO instead of entering a FreeRTOS critical
+ * section. Interrupts more urgent than that level keep running and must not
+ * call into lwIP. FreeRTOS API functions must not be called inside protected
+ * regions, as leaving a FreeRTOS critical section clears BASEPRI.
+ * Cortex-M3/M4 only.
+ */
+#ifndef LWIP_FREERTOS_SYS_ARCH_PROTECT_BASEPRI
+#define LWIP_FREERTOS_SYS_ARCH_PROTECT_BASEPRI        0
+#endif
+
+/** NVIC priority of the most urgent interrupt that calls into lwIP, unshifted
+ * like configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY.
+ */
+#ifndef LWIP_FREERTOS_SYS_ARCH_PROTECT_PRIO
+#define LWIP_FREERTOS_SYS_ARCH_PROTECT_PRIO           configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY
+#endif
+
+/** Set this to 1 to count outermost SYS_ARCH_PROTECT() regions and measure
+ * their total and maximum length with the DWT cycle counter.
+ * See sys_arch_protect_get_stats(). Requires LWIP_FREERTOS_SYS_ARCH_PROTECT_BASEPRI.
+ */
+#ifndef LWIP_FREERTOS_SYS_ARCH_PROTECT_STATS
+#define LWIP_FREERTOS_SYS_ARCH_PROTECT_STATS          0
+#endif
+
 /** Set this to 1 to include a sanity check that SYS_ARCH_PROTECT() and
  * SYS_ARCH_UNPROTECT() are called matching.
  */
@@ -82,7 +111,70 @@
 #define LWIP_FREERTOS_SYS_NOW_FROM_FREERTOS           1
 #endif
 
-#if !configSUPPORT_DYNAMIC_ALLOCATION
+/** Set this to 1 to implement sys_mbox_t as a lock-free ring of pointers
+ * instead of a FreeRTOS queue. Any task or ISR may post, but only one task
+ * may block in sys_arch_mbox_fetch() on a given mbox at a time. That task is
+ * woken with a task notification, sent only when it is actually blocked.
+ */
+#ifndef LWIP_FREERTOS_MBOX_RING
+#define LWIP_FREERTOS_MBOX_RING                       0
+#endif
+
+/** Task notification index used to wake a task blocked on a ring mbox */
+#ifndef LWIP_FREERTOS_MBOX_NOTIFY_INDEX
+#define LWIP_FREERTOS_MBOX_NOTIFY_INDEX               1
+#endif
+
+/** Number of tasks that may use netconn or socket calls at the same time
+ * with LWIP_NETCONN_SEM_PER_THREAD. Their semaphores come from a static pool.
+ */
+#ifndef LWIP_FREERTOS_NETCONN_SEM_CNT
+#define LWIP_FREERTOS_NETCONN_SEM_CNT                 8
+#endif
+
+/** Set this to 1 to create all threads, semaphores, mutexes and mboxes from
+ * compile-time sized pools with the FreeRTOS ...Static() functions instead
+ * of allocating them from the FreeRTOS heap.
+ */
+#ifndef LWIP_FREERTOS_STATIC_ALLOCATION
+#define LWIP_FREERTOS_STATIC_ALLOCATION               0
+#endif
+
+#if LWIP_FREERTOS_STATIC_ALLOCATION
+/** Number of semaphores and mutexes that may exist at the same time */
+#ifndef LWIP_FREERTOS_SEM_CNT
+#define LWIP_FREERTOS_SEM_CNT                         12
+#endif
+/** Number of mboxes that may exist at the same time */
+#ifndef LWIP_FREERTOS_MBOX_CNT
+#define LWIP_FREERTOS_MBOX_CNT                        12
+#endif
+/** Capacity of every pooled mbox, must not be lower than the largest of
+ * TCPIP_MBOX_SIZE and the DEFAULT_*_MBOX_SIZE options. Power of two with
+ * LWIP_FREERTOS_MBOX_RING.
+ */
+#ifndef LWIP_FREERTOS_MBOX_MAX_SIZE
+#define LWIP_FREERTOS_MBOX_MAX_SIZE                   32
+#endif
+/** Number of threads created with sys_thread_new() */
+#ifndef LWIP_FREERTOS_THREAD_CNT
+#define LWIP_FREERTOS_THREAD_CNT                      1
+#endif
+/** Stack size of every sys_thread_new() thread, in the same units as its
+ * stacksize argument */
+#ifndef LWIP_FREERTOS_THREAD_STACKSIZE
+#define LWIP_FREERTOS_THREAD_STACKSIZE                TCPIP_THREAD_STACKSIZE
+#endif
+#endif /* LWIP_FREERTOS_STATIC_ALLOCATION */
+
+#if LWIP_FREERTOS_STATIC_ALLOCATION
+#if !configSUPPORT_STATIC_ALLOCATION
+# error "LWIP_FREERTOS_STATIC_ALLOCATION requires configSUPPORT_STATIC_ALLOCATION"
+#endif
+#if LWIP_FREERTOS_MBOX_RING && ((LWIP_FREERTOS_MBOX_MAX_SIZE & (LWIP_FREERTOS_MBOX_MAX_SIZE - 1)) != 0)
+# error "LWIP_FREERTOS_MBOX_MAX_SIZE must be a power of two with LWIP_FREERTOS_MBOX_RING"
+#endif
+#elif !configSUPPORT_DYNAMIC_ALLOCATION
 # error "lwIP FreeRTOS port requires configSUPPORT_DYNAMIC_ALLOCATION"
 #endif
 #if !INCLUDE_vTaskDelay
@@ -91,28 +183,92 @@
 #if !INCLUDE_vTaskSuspend
 # error "lwIP FreeRTOS port requires INCLUDE_vTaskSuspend"
 #endif
+#if LWIP_FREERTOS_SYS_ARCH_PROTECT_BASEPRI && (LWIP_FREERTOS_SYS_ARCH_PROTECT_USES_MUTEX || LWIP_FREERTOS_SYS_ARCH_PROTECT_SANITY_CHECK)
+# error "LWIP_FREERTOS_SYS_ARCH_PROTECT_BASEPRI excludes the mutex and sanity check variants"
+#endif
+#if LWIP_FREERTOS_SYS_ARCH_PROTECT_BASEPRI && ((LWIP_FREERTOS_SYS_ARCH_PROTECT_PRIO < 1) || (LWIP_FREERTOS_SYS_ARCH_PROTECT_PRIO > configLIBRARY_LOWEST_INTERRUPT_PRIORITY))
+# error "LWIP_FREERTOS_SYS_ARCH_PROTECT_PRIO out of range"
+#endif
+#if LWIP_FREERTOS_SYS_ARCH_PROTECT_STATS && !LWIP_FREERTOS_SYS_ARCH_PROTECT_BASEPRI
+# error "LWIP_FREERTOS_SYS_ARCH_PROTECT_STATS requires LWIP_FREERTOS_SYS_ARCH_PROTECT_BASEPRI"
+#endif
+#if LWIP_FREERTOS_MBOX_RING && (configTASK_NOTIFICATION_ARRAY_ENTRIES <= LWIP_FREERTOS_MBOX_NOTIFY_INDEX)
+# error "LWIP_FREERTOS_MBOX_RING requires configTASK_NOTIFICATION_ARRAY_ENTRIES > LWIP_FREERTOS_MBOX_NOTIFY_INDEX"
+#endif
 #if LWIP_FREERTOS_SYS_ARCH_PROTECT_USES_MUTEX || !LWIP_COMPAT_MUTEX
 #if !configUSE_MUTEXES
 # error "lwIP FreeRTOS port requires configUSE_MUTEXES"
 #endif
 #endif
 
+#if LWIP_FREERTOS_SYS_ARCH_PROTECT_BASEPRI
+#include "stm32f4xx_hal.h"
+#endif
+
 #if SYS_LIGHTWEIGHT_PROT && LWIP_FREERTOS_SYS_ARCH_PROTECT_USES_MUTEX
 static SemaphoreHandle_t sys_arch_protect_mutex;
 #endif
+#if SYS_LIGHTWEIGHT_PROT && LWIP_FREERTOS_SYS_ARCH_PROTECT_BASEPRI
+#define SYS_ARCH_PROTECT_BASEPRI \
+	((u32_t)LWIP_FREERTOS_SYS_ARCH_PROTECT_PRIO << (8 - configPRIO_BITS))
+/* pval is the BASEPRI before sys_arch_protect(): the region is outermost
+ * if that did not mask the protect level yet */
+#define SYS_ARCH_PROTECT_OUTERMOST(pval) \
+	(((pval) == 0U) || ((pval) > SYS_ARCH_PROTECT_BASEPRI))
+#endif
+#if SYS_LIGHTWEIGHT_PROT && LWIP_FREERTOS_SYS_ARCH_PROTECT_STATS
+static struct sys_arch_protect_stats sys_arch_protect_stats;
+static u32_t sys_arch_protect_start;
+#endif
+#if LWIP_NETCONN_SEM_PER_THREAD
+LWIP_MEMPOOL_DECLARE(NETCONN_SEM, LWIP_FREERTOS_NETCONN_SEM_CNT, sizeof(sys_sem_t), "Per-thread netconn semaphores")
+#endif
 #if SYS_LIGHTWEIGHT_PROT && LWIP_FREERTOS_SYS_ARCH_PROTECT_SANITY_CHECK
 static sys_prot_t sys_arch_protect_nesting;
 #endif
+#if LWIP_FREERTOS_STATIC_ALLOCATION
+/* The handle of a statically created object is the address of its buffer,
+ * so buffers are returned to their pool through the handle on free.
+ * SYS_MBOX is declared with the mbox implementation. */
+LWIP_MEMPOOL_DECLARE(SYS_SEM, LWIP_FREERTOS_SEM_CNT, sizeof(StaticSemaphore_t), "sys_sem/sys_mutex")
+LWIP_MEMPOOL_PROTOTYPE(SYS_MBOX);
+
+#if LWIP_FREERTOS_THREAD_STACKSIZE_IS_STACKWORDS
+#define SYS_THREAD_STACK_WORDS  (LWIP_FREERTOS_THREAD_STACKSIZE)
+#else
+#define SYS_THREAD_STACK_WORDS  (LWIP_FREERTOS_THREAD_STACKSIZE / sizeof(StackType_t))
+#endif
+static StaticTask_t sys_thread_tcb[LWIP_FREERTOS_THREAD_CNT];
+static StackType_t sys_thread_stack[LWIP_FREERTOS_THREAD_CNT][SYS_THREAD_STACK_WORDS];
+static u32_t sys_thread_cnt;
+#endif /* LWIP_FREERTOS_STATIC_ALLOCATION */
 
 /* Initialize this module (see description in sys.h) */
 void sys_init(void)
 {
 #if SYS_LIGHTWEIGHT_PROT && LWIP_FREERTOS_SYS_ARCH_PROTECT_USES_MUTEX
 	/* initialize sys_arch_protect global mutex */
+#if LWIP_FREERTOS_STATIC_ALLOCATION
+	static StaticSemaphore_t sys_arch_protect_mutex_buf;
+	sys_arch_protect_mutex = xSemaphoreCreateRecursiveMutexStatic(&sys_arch_protect_mutex_buf);
+#else
 	sys_arch_protect_mutex = xSemaphoreCreateRecursiveMutex();
+#endif
 	LWIP_ASSERT("failed to create sys_arch_protect mutex",
 					sys_arch_protect_mutex != NULL);
 #endif /* SYS_LIGHTWEIGHT_PROT && LWIP_FREERTOS_SYS_ARCH_PROTECT_USES_MUTEX */
+#if LWIP_FREERTOS_STATIC_ALLOCATION
+	LWIP_MEMPOOL_INIT(SYS_SEM);
+	LWIP_MEMPOOL_INIT(SYS_MBOX);
+#endif
+#if LWIP_NETCONN_SEM_PER_THREAD
+	LWIP_MEMPOOL_INIT(NETCONN_SEM);
+#endif
+#if SYS_LIGHTWEIGHT_PROT && LWIP_FREERTOS_SYS_ARCH_PROTECT_STATS
+	/* enable the DWT cycle counter */
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif /* SYS_LIGHTWEIGHT_PROT && LWIP_FREERTOS_SYS_ARCH_PROTECT_STATS */
 }
 
 #if configUSE_16_BIT_TICKS == 1
@@ -126,6 +282,17 @@ u32_t sys_now(void)
 }
 #endif
 
+/* Converts a timeout to ticks, rounding up so that a wait is never shorter
+ * than requested and a short timeout does not turn into a zero-tick poll */
+static TickType_t sys_ms_to_ticks(u32_t ms)
+{
+	TickType_t ticks = ms / portTICK_RATE_MS;
+	if ((ms % portTICK_RATE_MS) != 0U) {
+		ticks++;
+	}
+	return ticks;
+}
+
 u32_t sys_jiffies(void)
 {
 	return xTaskGetTickCount();
@@ -141,6 +308,18 @@ sys_prot_t sys_arch_protect(void)
 
 	ret = xSemaphoreTakeRecursive(sys_arch_protect_mutex, portMAX_DELAY);
 	LWIP_ASSERT("sys_arch_protect failed to take the mutex", ret == pdTRUE);
+#elif LWIP_FREERTOS_SYS_ARCH_PROTECT_BASEPRI
+	/* BASEPRI_MAX only ever raises the mask, so nesting needs no counter */
+	sys_prot_t pval = __get_BASEPRI();
+	__set_BASEPRI_MAX(SYS_ARCH_PROTECT_BASEPRI);
+	__ISB();
+	__DSB();
+#if LWIP_FREERTOS_SYS_ARCH_PROTECT_STATS
+	if (SYS_ARCH_PROTECT_OUTERMOST(pval)) {
+		sys_arch_protect_start = DWT->CYCCNT;
+	}
+#endif
+	return pval;
 #else /* LWIP_FREERTOS_SYS_ARCH_PROTECT_USES_MUTEX */
 	taskENTER_CRITICAL();
 #endif /* LWIP_FREERTOS_SYS_ARCH_PROTECT_USES_MUTEX */
@@ -171,17 +350,38 @@ void sys_arch_unprotect(sys_prot_t pval)
 
 	ret = xSemaphoreGiveRecursive(sys_arch_protect_mutex);
 	LWIP_ASSERT("sys_arch_unprotect failed to give the mutex", ret == pdTRUE);
+#elif LWIP_FREERTOS_SYS_ARCH_PROTECT_BASEPRI
+#if LWIP_FREERTOS_SYS_ARCH_PROTECT_STATS
+	if (SYS_ARCH_PROTECT_OUTERMOST(pval)) {
+		u32_t cycles = DWT->CYCCNT - sys_arch_protect_start;
+		sys_arch_protect_stats.count++;
+		sys_arch_protect_stats.total_cycles += cycles;
+		if (cycles > sys_arch_protect_stats.max_cycles) {
+			sys_arch_protect_stats.max_cycles = cycles;
+		}
+	}
+#endif
+	__set_BASEPRI(pval);
 #else /* LWIP_FREERTOS_SYS_ARCH_PROTECT_USES_MUTEX */
 	taskEXIT_CRITICAL();
 #endif /* LWIP_FREERTOS_SYS_ARCH_PROTECT_USES_MUTEX */
 	LWIP_UNUSED_ARG(pval);
 }
 
+#if LWIP_FREERTOS_SYS_ARCH_PROTECT_STATS
+void sys_arch_protect_get_stats(struct sys_arch_protect_stats *stats)
+{
+	sys_prot_t pval = sys_arch_protect();
+	*stats = sys_arch_protect_stats;
+	sys_arch_unprotect(pval);
+}
+#endif /* LWIP_FREERTOS_SYS_ARCH_PROTECT_STATS */
+
 #endif /* SYS_LIGHTWEIGHT_PROT */
 
 void sys_arch_msleep(u32_t delay_ms)
 {
-	TickType_t delay_ticks = delay_ms / portTICK_RATE_MS;
+	TickType_t delay_ticks = sys_ms_to_ticks(delay_ms);
 	vTaskDelay(delay_ticks);
 }
 
@@ -192,7 +392,12 @@ err_t sys_mutex_new(sys_mutex_t *mutex)
 {
 	LWIP_ASSERT("mutex != NULL", mutex != NULL);
 
+#if LWIP_FREERTOS_STATIC_ALLOCATION
+	StaticSemaphore_t *buf = LWIP_MEMPOOL_ALLOC(SYS_SEM);
+	mutex->mut = (buf != NULL) ? xSemaphoreCreateRecursiveMutexStatic(buf) : NULL;
+#else
 	mutex->mut = xSemaphoreCreateRecursiveMutex();
+#endif
 	if(mutex->mut == NULL) {
 		SYS_STATS_INC(mutex.err);
 		return ERR_MEM;
@@ -228,6 +433,9 @@ void sys_mutex_free(sys_mutex_t *mutex)
 
 	SYS_STATS_DEC(mutex.used);
 	vSemaphoreDelete(mutex->mut);
+#if LWIP_FREERTOS_STATIC_ALLOCATION
+	LWIP_MEMPOOL_FREE(SYS_SEM, mutex->mut);
+#endif
 	mutex->mut = NULL;
 }
 
@@ -239,7 +447,12 @@ err_t sys_sem_new(sys_sem_t *sem, u8_t initial_count)
 	LWIP_ASSERT("initial_count invalid (not 0 or 1)",
 				(initial_count == 0) || (initial_count == 1));
 
+#if LWIP_FREERTOS_STATIC_ALLOCATION
+	StaticSemaphore_t *buf = LWIP_MEMPOOL_ALLOC(SYS_SEM);
+	sem->sem = (buf != NULL) ? xSemaphoreCreateBinaryStatic(buf) : NULL;
+#else
 	sem->sem = xSemaphoreCreateBinary();
+#endif
 	if(sem->sem == NULL) {
 		SYS_STATS_INC(sem.err);
 		return ERR_MEM;
@@ -276,7 +489,7 @@ u32_t sys_arch_sem_wait(sys_sem_t *sem, u32_t timeout_ms)
 		ret = xSemaphoreTake(sem->sem, portMAX_DELAY);
 		LWIP_ASSERT("taking semaphore failed", ret == pdTRUE);
 	} else {
-		TickType_t timeout_ticks = timeout_ms / portTICK_RATE_MS;
+		TickType_t timeout_ticks = sys_ms_to_ticks(timeout_ms);
 		ret = xSemaphoreTake(sem->sem, timeout_ticks);
 		if (ret == errQUEUE_EMPTY) {
 			/* timed out */
@@ -298,15 +511,308 @@ void sys_sem_free(sys_sem_t *sem)
 
 	SYS_STATS_DEC(sem.used);
 	vSemaphoreDelete(sem->sem);
+#if LWIP_FREERTOS_STATIC_ALLOCATION
+	LWIP_MEMPOOL_FREE(SYS_SEM, sem->sem);
+#endif
 	sem->sem = NULL;
 }
 
+#if LWIP_FREERTOS_MBOX_RING
+
+/* Bounded ring after D. Vyukov: every slot carries a sequence number telling
+ * whether it is free for the producer at 'pos' or filled for the consumer at
+ * 'pos', so head and tail only ever move by compare-and-swap. On Cortex-M4
+ * the __atomic builtins compile to LDREX/STREX loops. */
+struct mbox_slot {
+	u32_t seq;
+	void *msg;
+};
+
+struct mbox_ring {
+	u32_t head;
+	u32_t tail;
+	u32_t mask;
+	TaskHandle_t waiter;
+	struct mbox_slot slot[];
+};
+
+#if LWIP_FREERTOS_STATIC_ALLOCATION
+LWIP_MEMPOOL_DECLARE(SYS_MBOX, LWIP_FREERTOS_MBOX_CNT,
+		     sizeof(struct mbox_ring) + LWIP_FREERTOS_MBOX_MAX_SIZE * sizeof(struct mbox_slot),
+		     "sys_mbox")
+#endif
+
+static int mbox_ring_push(struct mbox_ring *ring, void *msg)
+{
+	u32_t pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	struct mbox_slot *slot;
+
+	for ( ; ; ) {
+		slot = &ring->slot[pos & ring->mask];
+		s32_t diff = (s32_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&ring->head, &pos, pos + 1U, 1,
+							__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if (diff < 0) {
+			/* full */
+			return 0;
+		} else {
+			/* another producer claimed this slot first */
+			pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+		}
+	}
+
+	slot->msg = msg;
+	__atomic_store_n(&slot->seq, pos + 1U, __ATOMIC_RELEASE);
+	return 1;
+}
+
+static int mbox_ring_pop(struct mbox_ring *ring, void **msg)
+{
+	u32_t pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+	struct mbox_slot *slot;
+
+	for ( ; ; ) {
+		slot = &ring->slot[pos & ring->mask];
+		s32_t diff = (s32_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - (pos + 1U));
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&ring->tail, &pos, pos + 1U, 1,
+							__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if (diff < 0) {
+			/* empty */
+			return 0;
+		} else {
+			pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+		}
+	}
+
+	*msg = slot->msg;
+	__atomic_store_n(&slot->seq, pos + ring->mask + 1U, __ATOMIC_RELEASE);
+	return 1;
+}
+
+static TaskHandle_t mbox_ring_waiter(struct mbox_ring *ring)
+{
+	/* Pairs with the fence in sys_arch_mbox_fetch(): either the consumer finds
+	 * the message on its re-check or we find it registered as waiter. */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	return __atomic_load_n(&ring->waiter, __ATOMIC_RELAXED);
+}
+
+static void mbox_ring_wake(struct mbox_ring *ring)
+{
+	TaskHandle_t waiter = mbox_ring_waiter(ring);
+	if (waiter != NULL) {
+		(void)xTaskNotifyGiveIndexed(waiter, LWIP_FREERTOS_MBOX_NOTIFY_INDEX);
+	}
+}
+
+err_t sys_mbox_new(sys_mbox_t *mbox, int size)
+{
+	struct mbox_ring *ring;
+	u32_t cnt = 1U;
+	u32_t i;
+	LWIP_ASSERT("mbox != NULL", mbox != NULL);
+	LWIP_ASSERT("size > 0", size > 0);
+
+	while (cnt < (u32_t)size) {
+		cnt <<= 1;
+	}
+
+#if LWIP_FREERTOS_STATIC_ALLOCATION
+	LWIP_ASSERT("size <= LWIP_FREERTOS_MBOX_MAX_SIZE", cnt <= LWIP_FREERTOS_MBOX_MAX_SIZE);
+	ring = LWIP_MEMPOOL_ALLOC(SYS_MBOX);
+#else
+	ring = pvPortMalloc(sizeof(struct mbox_ring) + cnt * sizeof(struct mbox_slot));
+#endif
+	if(ring == NULL) {
+		SYS_STATS_INC(mbox.err);
+		return ERR_MEM;
+	}
+	ring->head = 0U;
+	ring->tail = 0U;
+	ring->mask = cnt - 1U;
+	ring->waiter = NULL;
+	for (i = 0U; i < cnt; i++) {
+		ring->slot[i].seq = i;
+	}
+
+	mbox->mbx = ring;
+	SYS_STATS_INC_USED(mbox);
+	return ERR_OK;
+}
+
+void sys_mbox_post(sys_mbox_t *mbox, void *msg)
+{
+	LWIP_ASSERT("mbox != NULL", mbox != NULL);
+	LWIP_ASSERT("mbox->mbx != NULL", mbox->mbx != NULL);
+
+	TRACE(TRACE_MBOX_POST, msg);
+
+	while (!mbox_ring_push(mbox->mbx, msg)) {
+		/* There is no list of waiting producers, let the consumer drain */
+		vTaskDelay(1);
+	}
+	mbox_ring_wake(mbox->mbx);
+}
+
+err_t sys_mbox_trypost(sys_mbox_t *mbox, void *msg)
+{
+	LWIP_ASSERT("mbox != NULL", mbox != NULL);
+	LWIP_ASSERT("mbox->mbx != NULL", mbox->mbx != NULL);
+
+	TRACE(TRACE_MBOX_POST, msg);
+
+	if (!mbox_ring_push(mbox->mbx, msg)) {
+		SYS_STATS_INC(mbox.err);
+		return ERR_MEM;
+	}
+	mbox_ring_wake(mbox->mbx);
+	return ERR_OK;
+}
+
+err_t sys_mbox_trypost_fromisr(sys_mbox_t *mbox, void *msg)
+{
+	TaskHandle_t waiter;
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	LWIP_ASSERT("mbox != NULL", mbox != NULL);
+	LWIP_ASSERT("mbox->mbx != NULL", mbox->mbx != NULL);
+
+	TRACE(TRACE_MBOX_POST, msg);
+
+	if (!mbox_ring_push(mbox->mbx, msg)) {
+		SYS_STATS_INC(mbox.err);
+		return ERR_MEM;
+	}
+
+	waiter = mbox_ring_waiter(mbox->mbx);
+	if (waiter != NULL) {
+		vTaskNotifyGiveIndexedFromISR(waiter, LWIP_FREERTOS_MBOX_NOTIFY_INDEX,
+					      &xHigherPriorityTaskWoken);
+		if (xHigherPriorityTaskWoken == pdTRUE) {
+			return ERR_NEED_SCHED;
+		}
+	}
+	return ERR_OK;
+}
+
+u32_t sys_arch_mbox_fetch(sys_mbox_t *mbox, void **msg, u32_t timeout_ms)
+{
+	struct mbox_ring *ring;
+	TimeOut_t timeout;
+	TickType_t ticks_left;
+	void *msg_dummy;
+	LWIP_ASSERT("mbox != NULL", mbox != NULL);
+	LWIP_ASSERT("mbox->mbx != NULL", mbox->mbx != NULL);
+
+	if (!msg) {
+		msg = &msg_dummy;
+	}
+
+	ring = mbox->mbx;
+	if (mbox_ring_pop(ring, msg)) {
+		TRACE(TRACE_MBOX_FETCH, *msg);
+		return 1;
+	}
+
+	LWIP_ASSERT("mbox already has a blocked consumer", ring->waiter == NULL);
+	/* wait infinite if timeout_ms is 0 */
+	ticks_left = timeout_ms ? sys_ms_to_ticks(timeout_ms) : portMAX_DELAY;
+	vTaskSetTimeOutState(&timeout);
+
+	for ( ; ; ) {
+		__atomic_store_n(&ring->waiter, xTaskGetCurrentTaskHandle(), __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (mbox_ring_pop(ring, msg)) {
+			break;
+		}
+		if (xTaskCheckForTimeOut(&timeout, &ticks_left) != pdFALSE) {
+			/* timed out */
+			__atomic_store_n(&ring->waiter, NULL, __ATOMIC_RELAXED);
+			*msg = NULL;
+			return SYS_ARCH_TIMEOUT;
+		}
+		/* A notification left over from an earlier wake only costs a retry */
+		(void)ulTaskNotifyTakeIndexed(LWIP_FREERTOS_MBOX_NOTIFY_INDEX, pdTRUE, ticks_left);
+	}
+	__atomic_store_n(&ring->waiter, NULL, __ATOMIC_RELAXED);
+	TRACE(TRACE_MBOX_FETCH, *msg);
+
+	return 1;
+}
+
+u32_t sys_arch_mbox_tryfetch(sys_mbox_t *mbox, void **msg)
+{
+	void *msg_dummy;
+	LWIP_ASSERT("mbox != NULL", mbox != NULL);
+	LWIP_ASSERT("mbox->mbx != NULL", mbox->mbx != NULL);
+
+	if (!msg) {
+		msg = &msg_dummy;
+	}
+
+	if (!mbox_ring_pop(mbox->mbx, msg)) {
+		*msg = NULL;
+		return SYS_MBOX_EMPTY;
+	}
+	TRACE(TRACE_MBOX_FETCH, *msg);
+
+	return 0;
+}
+
+void sys_mbox_free(sys_mbox_t *mbox)
+{
+	LWIP_ASSERT("mbox != NULL", mbox != NULL);
+	LWIP_ASSERT("mbox->mbx != NULL", mbox->mbx != NULL);
+
+#if LWIP_FREERTOS_CHECK_QUEUE_EMPTY_ON_FREE
+	struct mbox_ring *ring = mbox->mbx;
+	u32_t msgs_waiting = ring->head - ring->tail;
+	LWIP_ASSERT("mbox quence not empty", msgs_waiting == 0);
+
+	if (msgs_waiting != 0) {
+		SYS_STATS_INC(mbox.err);
+	}
+#endif
+
+#if LWIP_FREERTOS_STATIC_ALLOCATION
+	LWIP_MEMPOOL_FREE(SYS_MBOX, mbox->mbx);
+#else
+	vPortFree(mbox->mbx);
+#endif
+
+	SYS_STATS_DEC(mbox.used);
+}
+
+#else /* LWIP_FREERTOS_MBOX_RING */
+
+#if LWIP_FREERTOS_STATIC_ALLOCATION
+struct sys_mbox_static {
+	StaticQueue_t queue;
+	void *storage[LWIP_FREERTOS_MBOX_MAX_SIZE];
+};
+
+LWIP_MEMPOOL_DECLARE(SYS_MBOX, LWIP_FREERTOS_MBOX_CNT, sizeof(struct sys_mbox_static), "sys_mbox")
+#endif
+
 err_t sys_mbox_new(sys_mbox_t *mbox, int size)
 {
 	LWIP_ASSERT("mbox != NULL", mbox != NULL);
 	LWIP_ASSERT("size > 0", size > 0);
 
+#if LWIP_FREERTOS_STATIC_ALLOCATION
+	struct sys_mbox_static *buf;
+	LWIP_ASSERT("size <= LWIP_FREERTOS_MBOX_MAX_SIZE", size <= LWIP_FREERTOS_MBOX_MAX_SIZE);
+	buf = LWIP_MEMPOOL_ALLOC(SYS_MBOX);
+	mbox->mbx = (buf != NULL) ? xQueueCreateStatic((UBaseType_t)size, sizeof(void *),
+						       (uint8_t *)buf->storage, &buf->queue) : NULL;
+#else
 	mbox->mbx = xQueueCreate((UBaseType_t)size, sizeof(void *));
+#endif
 	if(mbox->mbx == NULL) {
 		SYS_STATS_INC(mbox.err);
 		return ERR_MEM;
@@ -321,6 +827,8 @@ void sys_mbox_post(sys_mbox_t *mbox, void *msg)
 	LWIP_ASSERT("mbox != NULL", mbox != NULL);
 	LWIP_ASSERT("mbox->mbx != NULL", mbox->mbx != NULL);
 
+	TRACE(TRACE_MBOX_POST, msg);
+
 	ret = xQueueSendToBack(mbox->mbx, &msg, portMAX_DELAY);
 	LWIP_ASSERT("mbox post failed", ret == pdTRUE);
 }
@@ -331,6 +839,8 @@ err_t sys_mbox_trypost(sys_mbox_t *mbox, void *msg)
 	LWIP_ASSERT("mbox != NULL", mbox != NULL);
 	LWIP_ASSERT("mbox->mbx != NULL", mbox->mbx != NULL);
 
+	TRACE(TRACE_MBOX_POST, msg);
+
 	ret = xQueueSendToBack(mbox->mbx, &msg, 0);
 	if (ret == pdTRUE) {
 		return ERR_OK;
@@ -348,6 +858,8 @@ err_t sys_mbox_trypost_fromisr(sys_mbox_t *mbox, void *msg)
 	LWIP_ASSERT("mbox != NULL", mbox != NULL);
 	LWIP_ASSERT("mbox->mbx != NULL", mbox->mbx != NULL);
 
+	TRACE(TRACE_MBOX_POST, msg);
+
 	ret = xQueueSendToBackFromISR(mbox->mbx, &msg, &xHigherPriorityTaskWoken);
 	if (ret == pdTRUE) {
 		if (xHigherPriorityTaskWoken == pdTRUE) {
@@ -377,7 +889,7 @@ u32_t sys_arch_mbox_fetch(sys_mbox_t *mbox, void **msg, u32_t timeout_ms)
 		ret = xQueueReceive(mbox->mbx, &(*msg), portMAX_DELAY);
 		LWIP_ASSERT("mbox fetch failed", ret == pdTRUE);
 	} else {
-		TickType_t timeout_ticks = timeout_ms / portTICK_RATE_MS;
+		TickType_t timeout_ticks = sys_ms_to_ticks(timeout_ms);
 		ret = xQueueReceive(mbox->mbx, &(*msg), timeout_ticks);
 		if (ret == errQUEUE_EMPTY) {
 			/* timed out */
@@ -386,6 +898,7 @@ u32_t sys_arch_mbox_fetch(sys_mbox_t *mbox, void **msg, u32_t timeout_ms)
 		}
 		LWIP_ASSERT("mbox fetch failed", ret == pdTRUE);
 	}
+	TRACE(TRACE_MBOX_FETCH, *msg);
 
 	/* Old versions of lwIP required us to return the time waited.
 	 This is not the case any more. Just returning != SYS_ARCH_TIMEOUT
@@ -410,6 +923,7 @@ u32_t sys_arch_mbox_tryfetch(sys_mbox_t *mbox, void **msg)
 		return SYS_MBOX_EMPTY;
 	}
 	LWIP_ASSERT("mbox fetch failed", ret == pdTRUE);
+	TRACE(TRACE_MBOX_FETCH, *msg);
 
 	return 0;
 }
@@ -429,10 +943,15 @@ void sys_mbox_free(sys_mbox_t *mbox)
 #endif
 
 	vQueueDelete(mbox->mbx);
+#if LWIP_FREERTOS_STATIC_ALLOCATION
+	LWIP_MEMPOOL_FREE(SYS_MBOX, mbox->mbx);
+#endif
 
 	SYS_STATS_DEC(mbox.used);
 }
 
+#endif /* LWIP_FREERTOS_MBOX_RING */
+
 sys_thread_t sys_thread_new(const char *name, lwip_thread_fn thread, void *arg, int stacksize, int prio)
 {
 	TaskHandle_t rtos_task;
@@ -449,7 +968,22 @@ sys_thread_t sys_thread_new(const char *name, lwip_thread_fn thread, void *arg,
 
 	/* lwIP's lwip_thread_fn matches FreeRTOS' TaskFunction_t, so we can pass the
 	 thread function without adaption here. */
+#if LWIP_FREERTOS_STATIC_ALLOCATION
+	u32_t idx;
+	SYS_ARCH_DECL_PROTECT(lev);
+
+	LWIP_ASSERT("stacksize <= LWIP_FREERTOS_THREAD_STACKSIZE", rtos_stacksize <= SYS_THREAD_STACK_WORDS);
+	SYS_ARCH_PROTECT(lev);
+	idx = sys_thread_cnt++;
+	SYS_ARCH_UNPROTECT(lev);
+	LWIP_ASSERT("too many threads, raise LWIP_FREERTOS_THREAD_CNT", idx < LWIP_FREERTOS_THREAD_CNT);
+
+	rtos_task = xTaskCreateStatic(thread, name, SYS_THREAD_STACK_WORDS, arg, (unsigned)prio,
+				      sys_thread_stack[idx], &sys_thread_tcb[idx]);
+	ret = (rtos_task != NULL) ? pdTRUE : pdFALSE;
+#else
 	ret = xTaskCreate(thread, name, (configSTACK_DEPTH_TYPE)rtos_stacksize, arg, (unsigned)prio, &rtos_task);
+#endif
 	LWIP_ASSERT("task creation failed", ret == pdTRUE);
 
 	lwip_thread.thread_handle = rtos_task;
@@ -467,6 +1001,11 @@ sys_arch_netconn_sem_get(void)
   LWIP_ASSERT("task != NULL", task != NULL);
 
   ret = pvTaskGetThreadLocalStoragePointer(task, 0);
+  if(ret == NULL) {
+    /* first netconn call from this task */
+    sys_arch_netconn_sem_alloc();
+    ret = pvTaskGetThreadLocalStoragePointer(task, 0);
+  }
   return ret;
 }
 
@@ -482,7 +1021,7 @@ sys_arch_netconn_sem_alloc(void)
     sys_sem_t *sem;
     err_t err;
     /* need to allocate the memory for this semaphore */
-    sem = mem_malloc(sizeof(sys_sem_t));
+    sem = LWIP_MEMPOOL_ALLOC(NETCONN_SEM);
     LWIP_ASSERT("sem != NULL", sem != NULL);
     err = sys_sem_new(sem, 0);
     LWIP_ASSERT("err == ERR_OK", err == ERR_OK);
@@ -501,7 +1040,7 @@ void sys_arch_netconn_sem_free(void)
   if(ret != NULL) {
     sys_sem_t *sem = ret;
     sys_sem_free(sem);
-    mem_free(sem);
+    LWIP_MEMPOOL_FREE(NETCONN_SEM, sem);
     vTaskSetThreadLocalStoragePointer(task, 0, NULL);
   }
 }
@@ -560,9 +1099,8 @@ sys_check_core_locking(void)
   /* E.g. core Cortex-M3/M4 ports:
          configASSERT( ( portNVIC_INT_CTRL_REG & portVECTACTIVE_MASK ) == 0 );
 
-     Instead, we use more generic FreeRTOS functions here, which should fail from ISR: */
-  taskENTER_CRITICAL();
-  taskEXIT_CRITICAL();
+     Checked on IPSR, which leaves the interrupt mask alone: */
+  configASSERT(xPortIsInsideInterrupt() == pdFALSE);
 
 #if !NO_SYS
   if (lwip_tcpip_thread != 0) {
@@ -0,0 +1,20 @@
+#include "trace.h"
+
+#if TRACE_ENABLE
+
+struct trace_buf g_trace;
+
+void trace_init(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	__asm volatile ("dmb" : : : "memory");
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	g_trace.size = TRACE_RING_SIZE;
+	g_trace.hz = SystemCoreClock;
+	g_trace.head = 0U;
+	__asm volatile ("dmb" : : : "memory");
+	g_trace.magic = TRACE_MAGIC;
+}
+
+#endif /* TRACE_ENABLE */
@@ -0,0 +1,68 @@
+#include <string.h>
+
+#include "lwip/api.h"
+#include "lwip/netbuf.h"
+#include "lwip/pbuf.h"
+
+#include "udpzc.h"
+
+/* Waits for a datagram like netconn_recv(), honouring the receive timeout of
+ * conn. The datagram must be handed back with udpzc_release(). */
+err_t udpzc_recv(struct netconn *conn, struct udpzc_rx *rx)
+{
+	struct netbuf *buf = NULL;
+
+	err_t err = netconn_recv(conn, &buf);
+	if (err != ERR_OK) {
+		rx->buf = NULL;
+		return err;
+	}
+
+	rx->buf = buf;
+	rx->data = buf->p->payload;
+	rx->len = buf->p->len;
+	rx->tot_len = buf->p->tot_len;
+	ip_addr_copy(rx->addr, *netbuf_fromaddr(buf));
+	rx->port = netbuf_fromport(buf);
+
+	return ERR_OK;
+}
+
+/* Returns the buffers of a received datagram, may be called from any task */
+void udpzc_release(struct udpzc_rx *rx)
+{
+	netbuf_delete(rx->buf);
+	rx->buf = NULL;
+}
+
+static void udpzc_free(struct pbuf *p)
+{
+	struct udpzc_tx *tx = (struct udpzc_tx *)p;
+
+	tx->done(tx, tx->arg);
+}
+
+/* Sends len bytes at data without copying them. data and tx must stay valid
+ * until done is called. */
+err_t udpzc_sendto(struct netconn *conn, struct udpzc_tx *tx, const void *data, u16_t len,
+		   const ip_addr_t *addr, u16_t port, udpzc_done_fn done, void *arg)
+{
+	struct netbuf buf;
+
+	tx->done = done;
+	tx->arg = arg;
+	tx->pc.custom_free_function = udpzc_free;
+	/* PBUF_REF, the UDP and IP headers go into a pbuf chained in front */
+	struct pbuf *p = pbuf_alloced_custom(PBUF_RAW, len, PBUF_REF, &tx->pc, (void *)(uintptr_t)data, len);
+
+	/* netconn_sendto() is done with the netbuf when it returns */
+	memset(&buf, 0, sizeof(buf));
+	buf.p = p;
+	buf.ptr = p;
+	err_t err = netconn_sendto(conn, &buf, addr, port);
+
+	/* The TX path holds its own reference until the descriptor is released */
+	pbuf_free(p);
+
+	return err;
+}
@@ -0,0 +1,480 @@
+#ifndef ETH_SIM_H
+#define ETH_SIM_H
+
+/* Software ETH MAC behind the HAL_ETH_* calls of ethif.c, for host tests
+ * that include ethif.c before this file. The MAC is wired to a peer endpoint
+ * through an in-memory channel, the test sends and receives the frames of the
+ * peer. Interrupts, the ETH DMA and the PHY are simulated on the calling
+ * thread:
+ *
+ * - Frames handed to HAL_ETH_Transmit_IT() stay in the TX ring until
+ *   eth_sim_dma() copies them to the peer, the buffers of the frame are only
+ *   read then, as the DMA reads them. HAL_ETH_ReleaseTxPacket() hands the
+ *   pData of sent frames to HAL_ETH_TxFreeCallback().
+ * - Frames of the peer wait in the MAC FIFO until eth_sim_dma() writes them
+ *   into RX descriptors holding buffers of HAL_ETH_RxAllocateCallback().
+ *   HAL_ETH_ReadData() links the buffers of one frame with
+ *   HAL_ETH_RxLinkCallback() and refills the descriptors.
+ * - eth_sim_dma() raises the ETH interrupt if it completed a frame, the MAC
+ *   was started with HAL_ETH_Start_IT() and ETH_IRQn is enabled.
+ * - PHY registers are plain memory, preset as a KSZ8081 with a 100 Mbit/s
+ *   full duplex link.
+ *
+ * PTP timestamps are not simulated. */
+
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+#include "ethphy.h"
+
+/* Frames the channel holds in each direction */
+#define ETH_SIM_FIFO_LEN	32U
+
+struct eth_sim_frame {
+	uint16_t len;
+	uint8_t data[ETH_MAX_PACKET_SIZE];
+};
+
+struct eth_sim_fifo {
+	uint32_t head;
+	uint32_t tail;
+	struct eth_sim_frame frame[ETH_SIM_FIFO_LEN];
+};
+
+enum eth_sim_desc_state {
+	ETH_SIM_DESC_FREE,	/* owned by the driver */
+	ETH_SIM_DESC_DMA,	/* owned by the DMA */
+	ETH_SIM_DESC_DONE,	/* completed by the DMA, not read or released yet */
+};
+
+struct eth_sim_desc {
+	enum eth_sim_desc_state state;
+	uint8_t *buff;
+	uint32_t len;
+	int last;		/* last descriptor of a frame */
+	void *pData;		/* TX only, set on the last descriptor */
+};
+
+struct eth_sim_stats {
+	uint32_t tx_frames;	/* frames sent to the peer */
+	uint32_t tx_busy;	/* HAL_ETH_Transmit_IT() calls with a full TX ring */
+	uint32_t tx_dropped;	/* frames the peer had no room for */
+	uint32_t rx_frames;	/* frames written into RX descriptors */
+	uint32_t rx_missed;	/* frames of the peer with the MAC FIFO full */
+};
+
+static struct eth_sim {
+	ETH_HandleTypeDef *heth;
+	int started;
+	int irq_mode;		/* started with HAL_ETH_Start_IT() */
+	int irq_enabled;	/* ETH_IRQn enabled in the NVIC */
+	int rx_irq;
+	int tx_irq;
+	ETH_MACConfigTypeDef mac_config;
+	uint32_t phy[32];
+	struct eth_sim_desc rx[ETH_RX_DESC_CNT];
+	uint32_t rx_dma;	/* next descriptor the DMA writes */
+	uint32_t rx_read;	/* next descriptor HAL_ETH_ReadData() reads */
+	struct eth_sim_desc tx[ETH_TX_DESC_CNT];
+	uint32_t tx_cur;	/* next descriptor HAL_ETH_Transmit_IT() fills */
+	uint32_t tx_dma;	/* next descriptor the DMA sends */
+	uint32_t tx_release;	/* next descriptor HAL_ETH_ReleaseTxPacket() releases */
+	struct eth_sim_fifo to_mac;
+	struct eth_sim_fifo to_peer;
+	struct eth_sim_stats stats;
+} s_sim;
+
+/* The interrupt vector, defined by ethif.c */
+void ETH_IRQHandler(void);
+
+static int fifo_full(const struct eth_sim_fifo *f)
+{
+	return (f->head - f->tail) == ETH_SIM_FIFO_LEN;
+}
+
+static int fifo_empty(const struct eth_sim_fifo *f)
+{
+	return f->head == f->tail;
+}
+
+static struct eth_sim_frame *fifo_at(struct eth_sim_fifo *f, uint32_t pos)
+{
+	return &f->frame[pos % ETH_SIM_FIFO_LEN];
+}
+
+/* Back to power on, the MAC is reset by HAL_ETH_Init() */
+static void eth_sim_reset(void)
+{
+	memset(&s_sim, 0, sizeof(s_sim));
+	s_sim.phy[PHY_BASIC_CONTROL] = PHY_AUTONEG_ENABLE | PHY_SPEED_100M_SELECT | PHY_FULLDUPLEX_SELECT;
+	s_sim.phy[PHY_BASIC_STATUS] = PHY_LINKED_STATUS | PHY_AUTONEG_COMPLETE;
+	s_sim.phy[PHY_IDENTIFIER1] = 0x0022U;
+	s_sim.phy[PHY_IDENTIFIER2] = 0x1561U;
+	s_sim.phy[PHY_AUTONEG_ADVERTISEMENT] = PHY_ABILITY_100BASE_TX_FD | PHY_ABILITY_100BASE_TX |
+					       PHY_ABILITY_10BASE_T_FD | PHY_ABILITY_10BASE_T;
+	s_sim.phy[PHY_AUTONEG_LINK_PARTNER_ABILITY] = s_sim.phy[PHY_AUTONEG_ADVERTISEMENT];
+	s_sim.phy[PHY_CONTROL1] = PHY_OPERATION_MODE_100BASE_TX_FD;
+}
+
+/* Sends a frame of the peer to the MAC, returns 0 if the MAC FIFO is full */
+static int eth_sim_peer_send(const void *data, uint16_t len)
+{
+	if (fifo_full(&s_sim.to_mac) || (len > ETH_MAX_PACKET_SIZE)) {
+		s_sim.stats.rx_missed++;
+		return 0;
+	}
+	struct eth_sim_frame *f = fifo_at(&s_sim.to_mac, s_sim.to_mac.head++);
+	f->len = len;
+	memcpy(f->data, data, len);
+	return 1;
+}
+
+/* Receives a frame sent by the MAC, returns its length or 0 if there is none */
+static uint16_t eth_sim_peer_recv(void *data, uint16_t size)
+{
+	if (fifo_empty(&s_sim.to_peer)) {
+		return 0U;
+	}
+	struct eth_sim_frame *f = fifo_at(&s_sim.to_peer, s_sim.to_peer.tail++);
+	uint16_t len = (f->len < size) ? f->len : size;
+	memcpy(data, f->data, len);
+	return len;
+}
+
+/* Sets a PHY register as the PHY would, e.g. the link status or the
+ * interrupt status after a link change */
+static void eth_sim_phy_set(uint32_t reg, uint32_t val)
+{
+	s_sim.phy[reg & 31U] = val;
+}
+
+static uint32_t eth_sim_rx_ready(void)
+{
+	uint32_t cnt = 0U;
+
+	for (uint32_t i = 0U; i < ETH_RX_DESC_CNT; i++) {
+		const struct eth_sim_desc *d = &s_sim.rx[(s_sim.rx_dma + i) % ETH_RX_DESC_CNT];
+		if ((d->state != ETH_SIM_DESC_DMA) || (d->buff == NULL)) {
+			break;
+		}
+		cnt++;
+	}
+	return cnt;
+}
+
+/* Writes the frames waiting in the MAC FIFO into the RX descriptors. A frame
+ * waits until there are descriptors for all of it, as the DMA suspends on a
+ * descriptor it does not own. */
+static void eth_sim_dma_rx(void)
+{
+	uint32_t buff_len = s_sim.heth->Init.RxBuffLen;
+
+	while (!fifo_empty(&s_sim.to_mac)) {
+		struct eth_sim_frame *f = fifo_at(&s_sim.to_mac, s_sim.to_mac.tail);
+		uint32_t cnt = (f->len + buff_len - 1U) / buff_len;
+		if (eth_sim_rx_ready() < cnt) {
+			break;
+		}
+		for (uint32_t off = 0U; off < f->len; off += buff_len) {
+			struct eth_sim_desc *d = &s_sim.rx[s_sim.rx_dma];
+			d->len = ((f->len - off) < buff_len) ? (f->len - off) : buff_len;
+			memcpy(d->buff, &f->data[off], d->len);
+			d->last = (off + d->len) == f->len;
+			d->state = ETH_SIM_DESC_DONE;
+			s_sim.rx_dma = (s_sim.rx_dma + 1U) % ETH_RX_DESC_CNT;
+		}
+		s_sim.to_mac.tail++;
+		s_sim.stats.rx_frames++;
+		s_sim.rx_irq = 1;
+	}
+}
+
+/* Gathers the frames of the TX ring from their buffers and sends them */
+static void eth_sim_dma_tx(void)
+{
+	while (s_sim.tx[s_sim.tx_dma].state == ETH_SIM_DESC_DMA) {
+		struct eth_sim_frame frame = { .len = 0U };
+		int overrun = 0;
+		struct eth_sim_desc *d;
+
+		do {
+			d = &s_sim.tx[s_sim.tx_dma];
+			if (frame.len + d->len > sizeof(frame.data)) {
+				overrun = 1;
+			} else {
+				memcpy(&frame.data[frame.len], d->buff, d->len);
+				frame.len = (uint16_t)(frame.len + d->len);
+			}
+			d->state = ETH_SIM_DESC_DONE;
+			s_sim.tx_dma = (s_sim.tx_dma + 1U) % ETH_TX_DESC_CNT;
+		} while (!d->last);
+
+		if (overrun || fifo_full(&s_sim.to_peer)) {
+			s_sim.stats.tx_dropped++;
+		} else {
+			*fifo_at(&s_sim.to_peer, s_sim.to_peer.head++) = frame;
+			s_sim.stats.tx_frames++;
+		}
+		s_sim.tx_irq = 1;
+	}
+}
+
+/* Runs the DMA once over both rings and raises the interrupt of the frames it
+ * completed */
+static void eth_sim_dma(void)
+{
+	if (!s_sim.started) {
+		return;
+	}
+	eth_sim_dma_tx();
+	eth_sim_dma_rx();
+	if (s_sim.irq_mode && s_sim.irq_enabled && (s_sim.rx_irq || s_sim.tx_irq)) {
+		ETH_IRQHandler();
+	}
+}
+
+/* Hands empty RX descriptors to the DMA, as ETH_UpdateDescriptor() does:
+ * stops at the first buffer the allocation callback does not provide */
+static void eth_sim_rx_refill(void)
+{
+	for (uint32_t i = 0U; i < ETH_RX_DESC_CNT; i++) {
+		struct eth_sim_desc *d = &s_sim.rx[(s_sim.rx_read + i) % ETH_RX_DESC_CNT];
+		if (d->state != ETH_SIM_DESC_FREE) {
+			continue;
+		}
+		if (d->buff == NULL) {
+			HAL_ETH_RxAllocateCallback(&d->buff);
+			if (d->buff == NULL) {
+				break;
+			}
+		}
+		d->state = ETH_SIM_DESC_DMA;
+	}
+}
+
+HAL_StatusTypeDef HAL_ETH_Init(ETH_HandleTypeDef *heth)
+{
+	s_sim.heth = heth;
+	s_sim.started = 0;
+	s_sim.mac_config.Speed = ETH_SPEED_100M;
+	s_sim.mac_config.DuplexMode = ETH_FULLDUPLEX_MODE;
+	HAL_ETH_MspInit(heth);
+	return HAL_OK;
+}
+
+void HAL_ETH_SetMDIOClockRange(ETH_HandleTypeDef *heth)
+{
+	(void)heth;
+}
+
+HAL_StatusTypeDef HAL_ETH_ReadPHYRegister(ETH_HandleTypeDef *heth, uint32_t addr, uint32_t reg, uint32_t *val)
+{
+	(void)heth;
+	if ((addr != ETH_PHY_ADDR) || (reg > 31U)) {
+		return HAL_ERROR;
+	}
+	*val = s_sim.phy[reg];
+	if (reg == PHY_INTERRUPT_STATUS) {
+		/* Cleared on read */
+		s_sim.phy[reg] &= ~(uint32_t)(PHY_LINK_INT_UP_OCCURRED | PHY_LINK_INT_DOWN_OCCURED);
+	}
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ETH_WritePHYRegister(const ETH_HandleTypeDef *heth, uint32_t addr, uint32_t reg, uint32_t val)
+{
+	(void)heth;
+	if ((addr != ETH_PHY_ADDR) || (reg > 31U)) {
+		return HAL_ERROR;
+	}
+	if (reg == PHY_INTERRUPT_CONTROL) {
+		/* Enable bits in the high byte, the status below is read only */
+		s_sim.phy[reg] = (s_sim.phy[reg] & 0xFFU) | (val & 0xFF00U);
+	} else {
+		s_sim.phy[reg] = val & ~(uint32_t)PHY_AUTONEG_RESTART;
+	}
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ETH_GetMACConfig(ETH_HandleTypeDef *heth, ETH_MACConfigTypeDef *config)
+{
+	(void)heth;
+	*config = s_sim.mac_config;
+	return HAL_OK;
+}
+
+/* Only while the MAC is stopped, as the HAL */
+HAL_StatusTypeDef HAL_ETH_SetMACConfig(ETH_HandleTypeDef *heth, ETH_MACConfigTypeDef *config)
+{
+	(void)heth;
+	if (s_sim.started) {
+		return HAL_ERROR;
+	}
+	s_sim.mac_config = *config;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ETH_Start(ETH_HandleTypeDef *heth)
+{
+	(void)heth;
+	if (s_sim.started) {
+		return HAL_ERROR;
+	}
+	eth_sim_rx_refill();
+	s_sim.started = 1;
+	s_sim.irq_mode = 0;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ETH_Start_IT(ETH_HandleTypeDef *heth)
+{
+	HAL_StatusTypeDef status = HAL_ETH_Start(heth);
+
+	s_sim.irq_mode = (status == HAL_OK);
+	return status;
+}
+
+/* Descriptors keep their buffers, a restart only fills the empty ones */
+HAL_StatusTypeDef HAL_ETH_Stop(ETH_HandleTypeDef *heth)
+{
+	(void)heth;
+	if (!s_sim.started) {
+		return HAL_ERROR;
+	}
+	s_sim.started = 0;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ETH_Stop_IT(ETH_HandleTypeDef *heth)
+{
+	return HAL_ETH_Stop(heth);
+}
+
+static uint32_t eth_sim_tx_free(void)
+{
+	uint32_t cnt = 0U;
+
+	for (uint32_t i = 0U; i < ETH_TX_DESC_CNT; i++) {
+		if (s_sim.tx[(s_sim.tx_cur + i) % ETH_TX_DESC_CNT].state != ETH_SIM_DESC_FREE) {
+			break;
+		}
+		cnt++;
+	}
+	return cnt;
+}
+
+/* Takes one descriptor per buffer, a frame does not go out unless all of
+ * them are free, descriptors are free once released */
+HAL_StatusTypeDef HAL_ETH_Transmit_IT(ETH_HandleTypeDef *heth, ETH_TxPacketConfig *config)
+{
+	uint32_t cnt = 0U;
+
+	(void)heth;
+	for (const ETH_BufferTypeDef *b = config->TxBuffer; b != NULL; b = b->next) {
+		cnt++;
+	}
+	if (!s_sim.started || (cnt == 0U) || (cnt > eth_sim_tx_free())) {
+		s_sim.stats.tx_busy++;
+		return HAL_ERROR;
+	}
+
+	const ETH_BufferTypeDef *b = config->TxBuffer;
+	for (uint32_t i = 0U; i < cnt; i++, b = b->next) {
+		struct eth_sim_desc *d = &s_sim.tx[s_sim.tx_cur];
+		d->buff = b->buffer;
+		d->len = b->len;
+		d->last = (i + 1U) == cnt;
+		d->pData = d->last ? config->pData : NULL;
+		d->state = ETH_SIM_DESC_DMA;
+		s_sim.tx_cur = (s_sim.tx_cur + 1U) % ETH_TX_DESC_CNT;
+	}
+	return HAL_OK;
+}
+
+/* Blocks until the frame is sent */
+HAL_StatusTypeDef HAL_ETH_Transmit(ETH_HandleTypeDef *heth, ETH_TxPacketConfig *config, uint32_t timeout)
+{
+	(void)timeout;
+	HAL_StatusTypeDef status = HAL_ETH_Transmit_IT(heth, config);
+	if (status == HAL_OK) {
+		eth_sim_dma_tx();
+		s_sim.tx_irq = 0;
+		while (s_sim.tx[s_sim.tx_release].state == ETH_SIM_DESC_DONE) {
+			s_sim.tx[s_sim.tx_release].state = ETH_SIM_DESC_FREE;
+			s_sim.tx_release = (s_sim.tx_release + 1U) % ETH_TX_DESC_CNT;
+		}
+	}
+	return status;
+}
+
+HAL_StatusTypeDef HAL_ETH_ReleaseTxPacket(ETH_HandleTypeDef *heth)
+{
+	(void)heth;
+	while (s_sim.tx[s_sim.tx_release].state == ETH_SIM_DESC_DONE) {
+		struct eth_sim_desc *d = &s_sim.tx[s_sim.tx_release];
+		d->state = ETH_SIM_DESC_FREE;
+		s_sim.tx_release = (s_sim.tx_release + 1U) % ETH_TX_DESC_CNT;
+		if (d->last) {
+			HAL_ETH_TxFreeCallback(d->pData);
+		}
+	}
+	return HAL_OK;
+}
+
+/* Links the buffers of the next received frame, then refills the descriptors */
+HAL_StatusTypeDef HAL_ETH_ReadData(ETH_HandleTypeDef *heth, void **pAppBuff)
+{
+	void *end = NULL;
+	HAL_StatusTypeDef status = HAL_ERROR;
+
+	(void)heth;
+	*pAppBuff = NULL;
+	while (s_sim.rx[s_sim.rx_read].state == ETH_SIM_DESC_DONE) {
+		struct eth_sim_desc *d = &s_sim.rx[s_sim.rx_read];
+		HAL_ETH_RxLinkCallback(pAppBuff, &end, d->buff, (uint16_t)d->len);
+		d->buff = NULL;
+		d->state = ETH_SIM_DESC_FREE;
+		s_sim.rx_read = (s_sim.rx_read + 1U) % ETH_RX_DESC_CNT;
+		if (d->last) {
+			status = HAL_OK;
+			break;
+		}
+	}
+	eth_sim_rx_refill();
+	return status;
+}
+
+void HAL_ETH_IRQHandler(ETH_HandleTypeDef *heth)
+{
+	if (s_sim.rx_irq) {
+		s_sim.rx_irq = 0;
+		HAL_ETH_RxCpltCallback(heth);
+	}
+	if (s_sim.tx_irq) {
+		s_sim.tx_irq = 0;
+		HAL_ETH_TxCpltCallback(heth);
+	}
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type irq, uint32_t prio, uint32_t sub)
+{
+	(void)irq;
+	(void)prio;
+	(void)sub;
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type irq)
+{
+	if (irq == ETH_IRQn) {
+		s_sim.irq_enabled = 1;
+	}
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type irq)
+{
+	if (irq == ETH_IRQn) {
+		s_sim.irq_enabled = 0;
+	}
+}
+
+#endif /* ETH_SIM_H */
@@ -0,0 +1,272 @@
+#ifndef MBOX_TEST_H
+#define MBOX_TEST_H
+
+/* Stress test and benchmark of a sys_mbox_t backend, shared by the tests of
+ * the ring and the queue backend. FreeRTOS tasks are pthreads: task handles,
+ * notifications and timeouts are emulated here, the test of each backend
+ * includes sys_arch.c before this file. */
+
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "test.h"
+
+#define MBOX_TEST_PRODUCERS	4U
+#define MBOX_TEST_MSGS		200000U
+#define MBOX_TEST_SIZE		8
+#define MBOX_BENCH_MSGS		2000000U
+#define MBOX_BENCH_SIZE		32
+
+struct test_task {
+	sem_t notify;
+	int init;
+};
+
+static __thread struct test_task s_task;
+
+void *memp_malloc_pool(const struct memp_desc *d)
+{
+	return malloc((size_t)d->x);
+}
+
+void memp_free_pool(const struct memp_desc *d, void *m)
+{
+	(void)d;
+	free(m);
+}
+
+void *pvPortMalloc(size_t s)
+{
+	return malloc(s);
+}
+
+void vPortFree(void *p)
+{
+	free(p);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+	return (TickType_t)(now_ns() / 1000000U);
+}
+
+void vTaskDelay(TickType_t t)
+{
+	(void)t;
+	sched_yield();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	if (!s_task.init) {
+		sem_init(&s_task.notify, 0, 0);
+		s_task.init = 1;
+	}
+	return &s_task;
+}
+
+BaseType_t xTaskNotifyGiveIndexed(TaskHandle_t h, UBaseType_t i)
+{
+	(void)i;
+	sem_post(&((struct test_task *)h)->notify);
+	return pdPASS;
+}
+
+void vTaskNotifyGiveIndexedFromISR(TaskHandle_t h, UBaseType_t i, BaseType_t *w)
+{
+	(void)xTaskNotifyGiveIndexed(h, i);
+	*w = pdTRUE;
+}
+
+uint32_t ulTaskNotifyTakeIndexed(UBaseType_t i, BaseType_t clear, TickType_t t)
+{
+	struct test_task *task = xTaskGetCurrentTaskHandle();
+	uint32_t cnt = 0U;
+	int ret;
+	(void)i;
+
+	if (t == portMAX_DELAY) {
+		ret = sem_wait(&task->notify);
+	} else {
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		uint64_t end = (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec + (uint64_t)t * 1000000U;
+		ts.tv_sec = (time_t)(end / 1000000000U);
+		ts.tv_nsec = (long)(end % 1000000000U);
+		ret = sem_timedwait(&task->notify, &ts);
+	}
+	if (ret != 0) {
+		return 0U;
+	}
+	cnt++;
+	while (clear && (sem_trywait(&task->notify) == 0)) {
+		cnt++;
+	}
+	return cnt;
+}
+
+void vTaskSetTimeOutState(TimeOut_t *t)
+{
+	t->b = xTaskGetTickCount();
+}
+
+BaseType_t xTaskCheckForTimeOut(TimeOut_t *t, TickType_t *left)
+{
+	if (*left == portMAX_DELAY) {
+		return pdFALSE;
+	}
+	TickType_t now = xTaskGetTickCount();
+	TickType_t elapsed = now - t->b;
+	if (elapsed >= *left) {
+		*left = 0U;
+		return pdTRUE;
+	}
+	*left -= elapsed;
+	t->b = now;
+	return pdFALSE;
+}
+
+/* Messages carry their producer in the top byte and a sequence number below,
+ * so none is NULL */
+#define MSG(producer, seq)	((void *)(uintptr_t)((((uintptr_t)(producer) + 1U) << 24) | (seq)))
+#define MSG_PRODUCER(msg)	((uint32_t)((uintptr_t)(msg) >> 24) - 1U)
+#define MSG_SEQ(msg)		((uint32_t)((uintptr_t)(msg) & 0xFFFFFFU))
+
+struct producer {
+	pthread_t thread;
+	sys_mbox_t *mbox;
+	uint32_t id;
+	uint32_t msgs;
+	uint32_t full;
+};
+
+/* Even producers block in sys_mbox_post() on a full mbox, odd ones retry
+ * sys_mbox_trypost() */
+static void *producer_run(void *arg)
+{
+	struct producer *p = arg;
+
+	for (uint32_t seq = 0U; seq < p->msgs; seq++) {
+		if ((p->id & 1U) == 0U) {
+			sys_mbox_post(p->mbox, MSG(p->id, seq));
+			continue;
+		}
+		while (sys_mbox_trypost(p->mbox, MSG(p->id, seq)) != ERR_OK) {
+			p->full++;
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+/* Every message arrives exactly once and in the order of its producer */
+static void mbox_stress(sys_mbox_t *mbox)
+{
+	struct producer producers[MBOX_TEST_PRODUCERS];
+	uint32_t next[MBOX_TEST_PRODUCERS] = { 0U };
+	uint32_t full = 0U;
+
+	for (uint32_t i = 0U; i < MBOX_TEST_PRODUCERS; i++) {
+		producers[i] = (struct producer){ .mbox = mbox, .id = i, .msgs = MBOX_TEST_MSGS };
+		pthread_create(&producers[i].thread, NULL, producer_run, &producers[i]);
+	}
+
+	for (uint32_t n = 0U; n < MBOX_TEST_PRODUCERS * MBOX_TEST_MSGS; n++) {
+		void *msg = NULL;
+		CHECK(sys_arch_mbox_fetch(mbox, &msg, 0U) != SYS_ARCH_TIMEOUT);
+		uint32_t id = MSG_PRODUCER(msg);
+		CHECK(id < MBOX_TEST_PRODUCERS);
+		if (id < MBOX_TEST_PRODUCERS) {
+			CHECK(MSG_SEQ(msg) == next[id]);
+			next[id] = MSG_SEQ(msg) + 1U;
+		}
+	}
+
+	for (uint32_t i = 0U; i < MBOX_TEST_PRODUCERS; i++) {
+		pthread_join(producers[i].thread, NULL);
+		CHECK(next[i] == MBOX_TEST_MSGS);
+		full += producers[i].full;
+	}
+	void *msg;
+	CHECK(sys_arch_mbox_tryfetch(mbox, &msg) == SYS_MBOX_EMPTY);
+	printf("  %u messages, %u trypost retries on a full mbox\n",
+	       MBOX_TEST_PRODUCERS * MBOX_TEST_MSGS, full);
+}
+
+/* A full mbox refuses trypost until a message is fetched */
+static void mbox_full(sys_mbox_t *mbox, int size)
+{
+	void *msg;
+
+	for (int i = 0; i < size; i++) {
+		CHECK(sys_mbox_trypost(mbox, MSG(0U, i)) == ERR_OK);
+	}
+	CHECK(sys_mbox_trypost(mbox, MSG(0U, size)) == ERR_MEM);
+	CHECK(sys_arch_mbox_tryfetch(mbox, &msg) == 0U);
+	CHECK(msg == MSG(0U, 0U));
+	CHECK(sys_mbox_trypost(mbox, MSG(0U, size)) == ERR_OK);
+	for (int i = 1; i <= size; i++) {
+		CHECK(sys_arch_mbox_tryfetch(mbox, &msg) == 0U);
+		CHECK(msg == MSG(0U, i));
+	}
+	CHECK(sys_arch_mbox_tryfetch(mbox, &msg) == SYS_MBOX_EMPTY);
+}
+
+static void mbox_timeout(sys_mbox_t *mbox)
+{
+	void *msg = MSG(0U, 0U);
+	uint64_t start = now_ns();
+
+	CHECK(sys_arch_mbox_fetch(mbox, &msg, 20U) == SYS_ARCH_TIMEOUT);
+	CHECK(msg == NULL);
+	CHECK(now_ns() - start >= 19000000U);
+}
+
+static void *bench_producer(void *arg)
+{
+	sys_mbox_t *mbox = arg;
+
+	for (uint32_t seq = 0U; seq < MBOX_BENCH_MSGS; seq++) {
+		sys_mbox_post(mbox, MSG(0U, seq & 0xFFFFFFU));
+	}
+	return NULL;
+}
+
+/* Posts per second of one producer thread to a blocking consumer, and of
+ * post and fetch in one thread, which leaves out the wakeups */
+static void mbox_bench(sys_mbox_t *mbox, const char *name)
+{
+	pthread_t thread;
+	void *msg;
+
+	uint64_t start = now_ns();
+	pthread_create(&thread, NULL, bench_producer, mbox);
+	for (uint32_t n = 0U; n < MBOX_BENCH_MSGS; n++) {
+		(void)sys_arch_mbox_fetch(mbox, &msg, 0U);
+	}
+	pthread_join(thread, NULL);
+	double threaded = (double)MBOX_BENCH_MSGS * 1e9 / (double)(now_ns() - start);
+
+	start = now_ns();
+	for (uint32_t n = 0U; n < MBOX_BENCH_MSGS; n++) {
+		sys_mbox_post(mbox, MSG(0U, n & 0xFFFFFFU));
+		(void)sys_arch_mbox_tryfetch(mbox, &msg);
+	}
+	double single = (double)MBOX_BENCH_MSGS * 1e9 / (double)(now_ns() - start);
+
+	printf("  %s: %.0f posts/s to a blocking consumer, %.0f post+fetch/s in one thread\n",
+	       name, threaded, single);
+}
+
+#endif /* MBOX_TEST_H */
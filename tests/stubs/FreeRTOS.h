@@ -0,0 +1,33 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "FreeRTOSConfig.h"
+typedef uint32_t TickType_t; typedef long BaseType_t; typedef unsigned long UBaseType_t; typedef uint32_t StackType_t;
+#ifndef configSTACK_DEPTH_TYPE
+#define configSTACK_DEPTH_TYPE uint16_t
+#endif
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define errQUEUE_EMPTY 0
+#define errQUEUE_FULL 0
+#define portMAX_DELAY 0xffffffffUL
+#define portTICK_PERIOD_MS ((TickType_t)1000/configTICK_RATE_HZ)
+#define portTICK_RATE_MS portTICK_PERIOD_MS
+#define pdMS_TO_TICKS(x) ((TickType_t)(((TickType_t)(x) * (TickType_t)configTICK_RATE_HZ) / (TickType_t)1000U))
+#define portYIELD_FROM_ISR(x) (void)(x)
+#define portNVIC_INT_CTRL_REG (*(volatile uint32_t*)0xe000ed04)
+#define portVECTACTIVE_MASK 0xFFUL
+BaseType_t xPortIsInsideInterrupt(void);
+#ifndef configSUPPORT_DYNAMIC_ALLOCATION
+#define configSUPPORT_DYNAMIC_ALLOCATION 1
+#endif
+#ifndef configSUPPORT_STATIC_ALLOCATION
+#define configSUPPORT_STATIC_ALLOCATION 0
+#endif
+#ifndef configNUM_THREAD_LOCAL_STORAGE_POINTERS
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS 0
+#endif
+typedef struct { int x[20]; } StaticTask_t; typedef struct { int x[20]; } StaticQueue_t; typedef StaticQueue_t StaticSemaphore_t;
+void *pvPortMalloc(size_t s); void vPortFree(void *p);
+size_t xPortGetFreeHeapSize(void); size_t xPortGetMinimumEverFreeHeapSize(void);
@@ -0,0 +1,4 @@
+#pragma once
+#include <stdint.h>
+#define delay_us(US) ((void)(US))
+#define delay_ms(MS) ((void)(MS))
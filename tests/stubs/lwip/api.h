@@ -0,0 +1,8 @@
+#pragma once
+#include "lwip/pbuf.h"
+#include "lwip/ip_addr.h"
+#include "lwip/err.h"
+struct netconn;
+struct netbuf { struct pbuf *p, *ptr; ip_addr_t addr; u16_t port; };
+err_t netconn_recv(struct netconn *conn, struct netbuf **new_buf);
+err_t netconn_sendto(struct netconn *conn, struct netbuf *buf, const ip_addr_t *addr, u16_t port);
@@ -0,0 +1,3 @@
+#pragma once
+#include <assert.h>
+#define LWIP_ASSERT(m,a) assert((a) && (m))
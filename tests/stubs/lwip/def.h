@@ -0,0 +1,5 @@
+#pragma once
+#include "lwip/arch.h"
+#define LWIP_MIN(x,y) (((x)<(y))?(x):(y))
+u32_t lwip_htonl(u32_t x);
+#define lwip_ntohl(x) lwip_htonl(x)
@@ -0,0 +1,4 @@
+#pragma once
+#include "lwip/opt.h"
+#include "lwip/netif.h"
+int dhcp_start(struct netif*); int dhcp_supplied_address(const struct netif*); char *inet_ntoa(ip4_addr_t);
@@ -0,0 +1,3 @@
+#pragma once
+#include "lwip/netif.h"
+err_t etharp_output(struct netif *netif, struct pbuf *q, const ip4_addr_t *ipaddr);
@@ -0,0 +1,2 @@
+#include "lwip/netif.h"
+err_t igmp_joingroup_netif(struct netif *n, const ip4_addr_t *g);
@@ -0,0 +1,14 @@
+#pragma once
+#include "lwip/arch.h"
+typedef struct { u32_t addr; } ip4_addr_t; typedef ip4_addr_t ip_addr_t;
+#define ip_addr_set_zero_ip4(a) ((a)->addr=0)
+#define IP4_ADDR(a,b,c,d,e) ((a)->addr=0)
+#define IP_ADDR_ANY ((ip_addr_t*)0)
+#define IP_ANY_TYPE IP_ADDR_ANY
+#define IPADDR_TYPE_ANY 46U
+#define IP_GET_TYPE(a) ((u8_t)0U)
+#define ip_addr_copy(d,s) ((d)=(s))
+#define ip_addr_cmp(a,b) ((a)->addr == (b)->addr)
+#define IP4_ADDR_ANY IP_ADDR_ANY
+#define IPADDR_TYPE_V4 0U
+#define ip_addr_copy_from_ip4(d,s) ((d)=(s))
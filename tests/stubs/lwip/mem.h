@@ -0,0 +1,7 @@
+#pragma once
+#include "lwip/opt.h"
+#include "lwip/netif.h"
+void *mem_malloc(size_t); void mem_free(void*);
+#define SYS_STATS_INC(x)
+#define SYS_STATS_DEC(x)
+#define SYS_STATS_INC_USED(x)
@@ -0,0 +1,10 @@
+#pragma once
+#include "lwip/opt.h"
+struct memp_desc { int x; };
+#define LWIP_MEMPOOL_DECLARE(name,num,size,desc) u8_t memp_memory_##name##_base[(num)*(size)]; const struct memp_desc memp_##name = {sizeof(memp_memory_##name##_base)};
+#define LWIP_MEMPOOL_INIT(name) (void)memp_##name
+#define LWIP_MEMPOOL_ALLOC(name) memp_malloc_pool(&memp_##name)
+#define LWIP_MEMPOOL_FREE(name, x) memp_free_pool(&memp_##name, (x))
+void *memp_malloc_pool(const struct memp_desc *d);
+void memp_free_pool(const struct memp_desc *d, void *m);
+#define LWIP_MEMPOOL_PROTOTYPE(name) extern const struct memp_desc memp_ ## name
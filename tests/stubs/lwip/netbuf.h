@@ -0,0 +1,5 @@
+#pragma once
+#include "lwip/api.h"
+void netbuf_delete(struct netbuf *buf);
+#define netbuf_fromaddr(buf) (&((buf)->addr))
+#define netbuf_fromport(buf) ((buf)->port)
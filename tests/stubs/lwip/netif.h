@@ -0,0 +1,33 @@
+#pragma once
+#include "lwip/opt.h"
+#include "lwip/err.h"
+#include "lwip/pbuf.h"
+#include "lwip/ip_addr.h"
+struct netif;
+typedef err_t (*netif_input_fn)(struct pbuf *p, struct netif *inp);
+typedef err_t (*netif_init_fn)(struct netif *netif);
+typedef err_t (*netif_linkoutput_fn)(struct netif *netif, struct pbuf *p);
+typedef err_t (*netif_output_fn)(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr);
+enum netif_mac_filter_action { NETIF_DEL_MAC_FILTER = 0, NETIF_ADD_MAC_FILTER = 1 };
+typedef err_t (*netif_igmp_mac_filter_fn)(struct netif *netif, const ip4_addr_t *group, enum netif_mac_filter_action action);
+typedef void (*netif_status_callback_fn)(struct netif *netif);
+struct netif { struct netif *next; ip_addr_t ip_addr; netif_input_fn input; netif_output_fn output; netif_linkoutput_fn linkoutput; netif_igmp_mac_filter_fn igmp_mac_filter; void *state; const char *hostname; u16_t mtu; u8_t hwaddr[6]; u8_t hwaddr_len; u8_t flags; char name[2]; u8_t num; };
+#define NETIF_FLAG_UP 0x01U
+#define NETIF_FLAG_BROADCAST 0x02U
+#define NETIF_FLAG_LINK_UP 0x04U
+#define NETIF_FLAG_ETHARP 0x08U
+#define NETIF_FLAG_ETHERNET 0x10U
+#define NETIF_FLAG_IGMP 0x20U
+#define NETIF_FLAG_MLD6 0x40U
+#define ETHARP_HWADDR_LEN 6
+#define MIB2_INIT_NETIF(a,b,c)
+#define netif_is_up(n) (((n)->flags & NETIF_FLAG_UP) ? (u8_t)1 : (u8_t)0)
+#define netif_is_link_up(n) (((n)->flags & NETIF_FLAG_LINK_UP) ? (u8_t)1 : (u8_t)0)
+#define netif_set_igmp_mac_filter(n, f) do { (n)->igmp_mac_filter = f; } while(0)
+void netif_set_up(struct netif *n); void netif_set_down(struct netif *n);
+void netif_set_link_up(struct netif *n); void netif_set_link_down(struct netif *n);
+struct netif *netif_add(struct netif *netif, const ip4_addr_t *ipaddr, const ip4_addr_t *netmask, const ip4_addr_t *gw, void *state, netif_init_fn init, netif_input_fn input);
+void netif_set_default(struct netif *n);
+void netif_set_link_callback(struct netif *n, netif_status_callback_fn f);
+#include "lwip/def.h"
+#define ip4_addr_get_u32(a) ((a)->addr)
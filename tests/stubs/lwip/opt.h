@@ -0,0 +1,37 @@
+#pragma once
+#include "lwipopts.h"
+#include "lwip/arch.h"
+#include "lwip/debug.h"
+#ifndef LWIP_COMPAT_MUTEX
+#define LWIP_COMPAT_MUTEX 0
+#endif
+#ifndef LWIP_NETCONN_SEM_PER_THREAD
+#define LWIP_NETCONN_SEM_PER_THREAD 0
+#endif
+#ifndef LWIP_TCPIP_CORE_LOCKING
+#define LWIP_TCPIP_CORE_LOCKING 1
+#endif
+#ifndef LWIP_IPV6
+#define LWIP_IPV6 0
+#endif
+#ifndef LWIP_IGMP
+#define LWIP_IGMP 0
+#endif
+#ifndef LWIP_NETIF_HOSTNAME
+#define LWIP_NETIF_HOSTNAME 0
+#endif
+#ifndef LWIP_ETHERNET
+#define LWIP_ETHERNET 1
+#endif
+#ifndef MEMP_MEM_MALLOC
+#define MEMP_MEM_MALLOC 0
+#endif
+#ifndef PBUF_LINK_HLEN
+#define PBUF_LINK_HLEN 14
+#endif
+#ifndef PBUF_IP_HLEN
+#define PBUF_IP_HLEN 20
+#endif
+#ifndef PBUF_TRANSPORT_HLEN
+#define PBUF_TRANSPORT_HLEN 20
+#endif
@@ -0,0 +1,22 @@
+#pragma once
+#include "lwip/opt.h"
+#include "lwip/err.h"
+typedef enum { PBUF_TRANSPORT=74, PBUF_IP=54, PBUF_LINK=14, PBUF_RAW_TX=0, PBUF_RAW=0 } pbuf_layer;
+typedef enum { PBUF_RAM=0x280, PBUF_ROM=1, PBUF_REF=0x41, PBUF_POOL=0x182 } pbuf_type;
+struct pbuf { struct pbuf *next; void *payload; u16_t tot_len; u16_t len; u8_t type_internal; u8_t flags; u8_t ref; u8_t if_idx; };
+typedef void (*pbuf_free_custom_fn)(struct pbuf *p);
+struct pbuf_custom { struct pbuf pbuf; pbuf_free_custom_fn custom_free_function; };
+struct pbuf *pbuf_alloc(pbuf_layer l, u16_t length, pbuf_type type);
+struct pbuf *pbuf_alloced_custom(pbuf_layer l, u16_t length, pbuf_type type, struct pbuf_custom *p, void *payload_mem, u16_t payload_mem_len);
+void pbuf_ref(struct pbuf *p);
+u8_t pbuf_free(struct pbuf *p);
+void pbuf_cat(struct pbuf *head, struct pbuf *tail);
+void pbuf_chain(struct pbuf *head, struct pbuf *tail);
+err_t pbuf_take(struct pbuf *buf, const void *dataptr, u16_t len);
+u16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, u16_t len, u16_t offset);
+u8_t pbuf_remove_header(struct pbuf *p, size_t s);
+u8_t pbuf_add_header(struct pbuf *p, size_t s);
+u8_t pbuf_header(struct pbuf *p, s16_t s);
+u16_t pbuf_clen(const struct pbuf *p);
+err_t pbuf_copy(struct pbuf *p_to, const struct pbuf *p_from);
+#define PBUF_FLAG_IS_CUSTOM 0x02U
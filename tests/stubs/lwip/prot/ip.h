@@ -0,0 +1 @@
+#define IP_PROTO_UDP 17
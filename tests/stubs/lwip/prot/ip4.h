@@ -0,0 +1 @@
+#define IP_HLEN 20
@@ -0,0 +1 @@
+#define UDP_HLEN 8
@@ -0,0 +1,8 @@
+#pragma once
+#include "lwip/opt.h"
+#include "lwip/netif.h"
+#if LWIP_STATS && MIB2_STATS
+struct stats_mib2 { u32_t tcpretranssegs; };
+struct stats_ { struct stats_mib2 mib2; };
+extern struct stats_ lwip_stats;
+#endif
@@ -0,0 +1,15 @@
+#pragma once
+#include "lwip/opt.h"
+#include "lwip/err.h"
+#include "arch/sys_arch.h"
+#define SYS_ARCH_TIMEOUT 0xffffffffUL
+#define SYS_MBOX_EMPTY SYS_ARCH_TIMEOUT
+typedef void (*lwip_thread_fn)(void *arg);
+u32_t sys_now(void);
+#define SYS_ARCH_DECL_PROTECT(lev) sys_prot_t lev
+#define SYS_ARCH_PROTECT(lev) lev = sys_arch_protect()
+#define SYS_ARCH_UNPROTECT(lev) sys_arch_unprotect(lev)
+sys_prot_t sys_arch_protect(void); void sys_arch_unprotect(sys_prot_t);
+err_t sys_sem_new(sys_sem_t *sem, u8_t count);
+void sys_sem_free(sys_sem_t *sem);
+void sys_mutex_lock(sys_mutex_t *m); void sys_mutex_unlock(sys_mutex_t *m);
@@ -0,0 +1,21 @@
+#pragma once
+#include "lwip/sys.h"
+#include "lwip/netif.h"
+typedef void (*tcpip_init_done_fn)(void *arg);
+typedef void (*tcpip_callback_fn)(void *ctx);
+void tcpip_init(tcpip_init_done_fn f, void *arg);
+err_t tcpip_input(struct pbuf *p, struct netif *inp);
+err_t tcpip_callback(tcpip_callback_fn f, void *ctx);
+err_t tcpip_try_callback(tcpip_callback_fn f, void *ctx);
+#if LWIP_TCPIP_CORE_LOCKING
+extern sys_mutex_t lock_tcpip_core;
+#ifndef LOCK_TCPIP_CORE
+#define LOCK_TCPIP_CORE()     sys_mutex_lock(&lock_tcpip_core)
+#define UNLOCK_TCPIP_CORE()   sys_mutex_unlock(&lock_tcpip_core)
+#endif
+#endif
+struct tcpip_callback_msg;
+struct tcpip_callback_msg *tcpip_callbackmsg_new(tcpip_callback_fn f, void *ctx);
+void tcpip_callbackmsg_delete(struct tcpip_callback_msg *m);
+err_t tcpip_callbackmsg_trycallback(struct tcpip_callback_msg *m);
+err_t tcpip_callbackmsg_trycallback_fromisr(struct tcpip_callback_msg *m);
@@ -0,0 +1,9 @@
+#pragma once
+#include "lwip/netif.h"
+err_t ethernet_input(struct pbuf *p, struct netif *netif);
+#define LL_IP4_MULTICAST_ADDR_0 0x01
+#define LL_IP4_MULTICAST_ADDR_1 0x00
+#define LL_IP4_MULTICAST_ADDR_2 0x5e
+#define LL_IP6_MULTICAST_ADDR_0 0x33
+#define LL_IP6_MULTICAST_ADDR_1 0x33
+#define SIZEOF_ETH_HDR 14U
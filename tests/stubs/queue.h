@@ -0,0 +1,10 @@
+#pragma once
+#include "FreeRTOS.h"
+typedef void *QueueHandle_t;
+QueueHandle_t xQueueCreate(UBaseType_t l, UBaseType_t s);
+QueueHandle_t xQueueCreateStatic(UBaseType_t l, UBaseType_t s, uint8_t *b, StaticQueue_t *q);
+BaseType_t xQueueSendToBack(QueueHandle_t q, const void *i, TickType_t t);
+BaseType_t xQueueSendToBackFromISR(QueueHandle_t q, const void *i, BaseType_t *w);
+BaseType_t xQueueReceive(QueueHandle_t q, void *i, TickType_t t);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q);
+void vQueueDelete(QueueHandle_t q);
@@ -0,0 +1,191 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#define __ALIGNED(x) __attribute__((aligned(x)))
+#define __IO volatile
+#define __STATIC_FORCEINLINE static inline
+typedef enum { HAL_OK, HAL_ERROR, HAL_BUSY, HAL_TIMEOUT } HAL_StatusTypeDef;
+typedef enum { RESET = 0, SET = 1 } FlagStatus;
+typedef enum { DISABLE = 0, ENABLE = 1 } FunctionalState;
+typedef struct { uint32_t Pin, Mode, Pull, Speed, Alternate; } GPIO_InitTypeDef;
+typedef struct { volatile uint32_t MODER, IDR, ODR; } GPIO_TypeDef;
+typedef enum { GPIO_PIN_RESET, GPIO_PIN_SET } GPIO_PinState;
+extern GPIO_TypeDef *GPIOA, *GPIOB, *GPIOC, *GPIOD, *GPIOE;
+#define GPIO_PIN_0 0x1U
+#define GPIO_PIN_1 0x2U
+#define GPIO_PIN_2 0x4U
+#define GPIO_PIN_4 0x10U
+#define GPIO_PIN_5 0x20U
+#define GPIO_PIN_7 0x80U
+#define GPIO_PIN_8 0x100U
+#define GPIO_PIN_10 0x400U
+#define GPIO_PIN_11 0x800U
+#define GPIO_PIN_12 0x1000U
+#define GPIO_PIN_13 0x2000U
+#define GPIO_PIN_15 0x8000U
+#define GPIO_MODE_OUTPUT_PP 1U
+#define GPIO_MODE_OUTPUT_OD 0x11U
+#define GPIO_MODE_AF_PP 2U
+#define GPIO_MODE_INPUT 0U
+#define GPIO_MODE_IT_FALLING 0x10210000U
+#define GPIO_NOPULL 0U
+#define GPIO_PULLUP 1U
+#define GPIO_SPEED_MEDIUM 1U
+#define GPIO_SPEED_FREQ_LOW 0U
+#define GPIO_SPEED_FREQ_VERY_HIGH 3U
+#define GPIO_AF11_ETH 11U
+void HAL_GPIO_Init(GPIO_TypeDef *p, GPIO_InitTypeDef *i); void HAL_GPIO_DeInit(GPIO_TypeDef *p, uint32_t pin);
+void HAL_GPIO_WritePin(GPIO_TypeDef *p, uint16_t pin, GPIO_PinState s); void HAL_GPIO_TogglePin(GPIO_TypeDef *p, uint16_t pin);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *p, uint16_t pin);
+void HAL_GPIO_EXTI_IRQHandler(uint16_t pin);
+void HAL_GPIO_EXTI_Callback(uint16_t pin);
+#define __HAL_RCC_GPIOA_CLK_ENABLE() do{}while(0)
+#define __HAL_RCC_GPIOB_CLK_ENABLE() do{}while(0)
+#define __HAL_RCC_GPIOC_CLK_ENABLE() do{}while(0)
+#define __HAL_RCC_GPIOD_CLK_ENABLE() do{}while(0)
+#define __HAL_RCC_GPIOE_CLK_ENABLE() do{}while(0)
+#define __HAL_RCC_SYSCFG_CLK_ENABLE() do{}while(0)
+#define __HAL_RCC_ETH_CLK_ENABLE() do{}while(0)
+#define __HAL_RCC_ETHMAC_CLK_ENABLE() do{}while(0)
+#define __HAL_RCC_ETHMACTX_CLK_ENABLE() do{}while(0)
+#define __HAL_RCC_ETHMACRX_CLK_ENABLE() do{}while(0)
+#define __HAL_RCC_ETHMACPTP_CLK_ENABLE() do{}while(0)
+#define __HAL_RCC_PWR_CLK_ENABLE() do{}while(0)
+#define __HAL_PWR_VOLTAGESCALING_CONFIG(x) do{}while(0)
+typedef enum { ETH_IRQn = 61, EXTI0_IRQn = 6, EXTI1_IRQn = 7, EXTI2_IRQn=8, EXTI3_IRQn=9, EXTI4_IRQn=10, EXTI9_5_IRQn=23, EXTI15_10_IRQn=40 } IRQn_Type;
+void HAL_NVIC_SetPriority(IRQn_Type i, uint32_t p, uint32_t s); void HAL_NVIC_EnableIRQ(IRQn_Type i); void HAL_NVIC_DisableIRQ(IRQn_Type i);
+/* ETH */
+typedef struct { volatile uint32_t MACCR, MACFFR, MACHTHR, MACHTLR, MACMIIAR, MACMIIDR, MACA0HR, MACA0LR, MACA1HR, MACA1LR, MACA2HR, MACA2LR, MACA3HR, MACA3LR, PTPTSCR, PTPSSIR, PTPTSHR, PTPTSLR, PTPTSHUR, PTPTSLUR, PTPTSAR, PTPTTHR, PTPTTLR, DMABMR, DMASR, DMAIER, MACIMR, MACSR; } ETH_TypeDef;
+extern ETH_TypeDef *ETH;
+typedef struct { volatile uint32_t DESC0, DESC1, DESC2, DESC3, DESC4, DESC5, DESC6, DESC7; uint32_t BackupAddr0, BackupAddr1; } ETH_DMADescTypeDef;
+typedef struct __ETH_BufferTypeDef { uint8_t *buffer; uint32_t len; struct __ETH_BufferTypeDef *next; } ETH_BufferTypeDef;
+typedef struct { uint32_t Attributes; uint32_t Length; ETH_BufferTypeDef *TxBuffer; uint32_t SrcAddrCtrl; uint32_t CRCPadCtrl; uint32_t ChecksumCtrl; uint32_t MaxSegmentSize; uint32_t PayloadLen; uint32_t TCPHeaderLen; uint32_t VlanTag; uint32_t VlanCtrl; uint32_t InnerVlanTag; uint32_t InnerVlanCtrl; void *pData; } ETH_TxPacketConfig;
+typedef enum { HAL_ETH_MII_MODE, HAL_ETH_RMII_MODE } ETH_MediaInterfaceTypeDef;
+typedef struct { uint8_t *MACAddr; ETH_MediaInterfaceTypeDef MediaInterface; ETH_DMADescTypeDef *TxDesc; ETH_DMADescTypeDef *RxDesc; uint32_t RxBuffLen; } ETH_InitTypeDef;
+typedef struct { uint32_t SourceAddrControl; FunctionalState ChecksumOffload; uint32_t InterPacketGapVal; FunctionalState GiantPacketSizeLimitControl; FunctionalState Support2KPacket; FunctionalState CRCStripTypePacket; FunctionalState AutomaticPadCRCStrip; FunctionalState Watchdog; FunctionalState Jabber; FunctionalState JumboPacket; uint32_t Speed; uint32_t DuplexMode; FunctionalState LoopbackMode; FunctionalState CarrierSenseBeforeTransmit; FunctionalState ReceiveOwn; FunctionalState CarrierSenseDuringTransmit; FunctionalState RetryTransmission; uint32_t BackOffLimit; FunctionalState DeferralCheck; } ETH_MACConfigTypeDef;
+typedef struct { FunctionalState PromiscuousMode; FunctionalState ReceiveAllMode; FunctionalState HashOrPerfectFilter; FunctionalState HashUnicast; FunctionalState HashMulticast; FunctionalState PassAllMulticast; FunctionalState SrcAddrFiltering; FunctionalState SrcAddrInverseFiltering; FunctionalState DestAddrInverseFiltering; FunctionalState BroadcastFilter; uint32_t ControlPacketsFilter; } ETH_MACFilterConfigTypeDef;
+typedef struct { uint32_t TimeStampHigh; uint32_t TimeStampLow; } ETH_TimeStampTypeDef;
+typedef struct { ETH_TypeDef *Instance; ETH_InitTypeDef Init; volatile uint32_t gState; volatile uint32_t ErrorCode; struct { uint32_t CurRxDesc; ETH_TimeStampTypeDef TimeStamp; } RxDescList; struct { uint32_t TxDesc[4]; uint32_t CurTxDesc; } TxDescList; } ETH_HandleTypeDef;
+#define ETH_DMATXDESC_OWN 0x80000000U
+#define ETH_DMATXDESC_TTSE 0x02000000U
+uint32_t HAL_RCC_GetHCLKFreq(void);
+#define ETH_TX_DESC_CNT 4U
+#define ETH_RX_DESC_CNT 4U
+#define ETH_RX_BUF_SIZE 1536
+#define ETH_TX_BUF_SIZE ETH_MAX_PACKET_SIZE
+#define MAC_ADDR0 2U
+#define MAC_ADDR1 2U
+#define MAC_ADDR2 2U
+#define MAC_ADDR3 2U
+#define MAC_ADDR4 2U
+#define MAC_ADDR5 2U
+#define ETH_MAX_PACKET_SIZE 1528U
+#define ETH_TX_PACKETS_FEATURES_CSUM 1U
+#define ETH_TX_PACKETS_FEATURES_CRCPAD 2U
+#define ETH_CHECKSUM_IPHDR_PAYLOAD_INSERT_PHDR_CALC 3U
+#define ETH_CRC_PAD_INSERT 0U
+#define ETH_SPEED_100M 0x4000U
+#define ETH_SPEED_10M 0U
+#define ETH_FULLDUPLEX_MODE 0x800U
+#define ETH_HALFDUPLEX_MODE 0U
+#define HAL_ETH_ERROR_BUSY 0x2U
+#define ETH_MACA1HR_AE 0x80000000U
+#define ETH_MACA1HR_SA 0x40000000U
+#define ETH_MAC_ADDRESS1 0x8U
+#define ETH_MAC_ADDRESS2 0x10U
+#define ETH_MAC_ADDRESS3 0x18U
+HAL_StatusTypeDef HAL_ETH_Init(ETH_HandleTypeDef *h);
+HAL_StatusTypeDef HAL_ETH_Start(ETH_HandleTypeDef *h); HAL_StatusTypeDef HAL_ETH_Start_IT(ETH_HandleTypeDef *h);
+HAL_StatusTypeDef HAL_ETH_Stop(ETH_HandleTypeDef *h); HAL_StatusTypeDef HAL_ETH_Stop_IT(ETH_HandleTypeDef *h);
+HAL_StatusTypeDef HAL_ETH_Transmit(ETH_HandleTypeDef *h, ETH_TxPacketConfig *c, uint32_t t);
+HAL_StatusTypeDef HAL_ETH_Transmit_IT(ETH_HandleTypeDef *h, ETH_TxPacketConfig *c);
+HAL_StatusTypeDef HAL_ETH_ReleaseTxPacket(ETH_HandleTypeDef *h);
+HAL_StatusTypeDef HAL_ETH_ReadData(ETH_HandleTypeDef *h, void **p);
+HAL_StatusTypeDef HAL_ETH_ReadPHYRegister(ETH_HandleTypeDef *h, uint32_t a, uint32_t r, uint32_t *v);
+HAL_StatusTypeDef HAL_ETH_WritePHYRegister(const ETH_HandleTypeDef *h, uint32_t a, uint32_t r, uint32_t v);
+HAL_StatusTypeDef HAL_ETH_GetMACConfig(ETH_HandleTypeDef *h, ETH_MACConfigTypeDef *c);
+HAL_StatusTypeDef HAL_ETH_SetMACConfig(ETH_HandleTypeDef *h, ETH_MACConfigTypeDef *c);
+HAL_StatusTypeDef HAL_ETH_GetMACFilterConfig(ETH_HandleTypeDef *h, ETH_MACFilterConfigTypeDef *c);
+HAL_StatusTypeDef HAL_ETH_SetMACFilterConfig(ETH_HandleTypeDef *h, ETH_MACFilterConfigTypeDef *c);
+HAL_StatusTypeDef HAL_ETH_SetHashTable(ETH_HandleTypeDef *h, uint32_t *t);
+HAL_StatusTypeDef HAL_ETH_SetSourceMACAddrMatch(ETH_HandleTypeDef *h, uint32_t a, uint8_t *m);
+void HAL_ETH_SetMDIOClockRange(ETH_HandleTypeDef *h);
+void HAL_ETH_IRQHandler(ETH_HandleTypeDef *h);
+void HAL_ETH_RxCpltCallback(ETH_HandleTypeDef *h); void HAL_ETH_TxCpltCallback(ETH_HandleTypeDef *h);
+void HAL_ETH_RxAllocateCallback(uint8_t **buff);
+void HAL_ETH_RxLinkCallback(void **s, void **e, uint8_t *b, uint16_t l);
+void HAL_ETH_TxFreeCallback(uint32_t *b);
+void HAL_ETH_TxPtpCallback(uint32_t *buff, ETH_TimeStampTypeDef *ts);
+/* stm32f4xx_hal_conf.h */
+#if defined(ETHIF_PTP) && ETHIF_PTP
+#define HAL_ETH_USE_PTP
+#endif
+#ifdef HAL_ETH_USE_PTP
+typedef struct { uint32_t Timestamp, TimestampUpdateMode, TimestampInitialize, TimestampUpdate, TimestampAddendUpdate, TimestampAll, TimestampRolloverMode, TimestampV2, TimestampEthernet, TimestampIPv6, TimestampIPv4, TimestampEvent, TimestampMaster, TimestampFilter, TimestampClockType, TimestampAddend, TimestampSubsecondInc; } ETH_PTP_ConfigTypeDef;
+typedef struct { uint32_t Seconds; uint32_t NanoSeconds; } ETH_TimeTypeDef;
+HAL_StatusTypeDef HAL_ETH_PTP_SetConfig(ETH_HandleTypeDef *h, ETH_PTP_ConfigTypeDef *c);
+HAL_StatusTypeDef HAL_ETH_PTP_SetTime(ETH_HandleTypeDef *h, ETH_TimeTypeDef *t);
+HAL_StatusTypeDef HAL_ETH_PTP_GetTime(ETH_HandleTypeDef *h, ETH_TimeTypeDef *t);
+HAL_StatusTypeDef HAL_ETH_PTP_InsertTxTimestamp(ETH_HandleTypeDef *h);
+HAL_StatusTypeDef HAL_ETH_PTP_GetRxTimestamp(ETH_HandleTypeDef *h, ETH_TimeStampTypeDef *t);
+#endif
+void HAL_ETH_MspInit(ETH_HandleTypeDef *h);
+/* core */
+typedef struct { volatile uint32_t CR1, EGR, PSC, ARR, CNT, SR, DIER, CCR1, CCMR1, CCER; } TIM_TypeDef;
+extern TIM_TypeDef *TIM2;
+#define TIM_EGR_UG 1U
+#define TIM_CR1_CEN 1U
+typedef struct { volatile uint32_t APB1ENR, AHB1ENR; } RCC_TypeDef;
+extern RCC_TypeDef *RCC;
+#define RCC_APB1ENR_TIM2EN 1U
+typedef struct { volatile uint32_t CTRL, CYCCNT; } DWT_Type;
+extern DWT_Type *DWT;
+#define DWT_CTRL_CYCCNTENA_Msk 1UL
+typedef struct { volatile uint32_t DEMCR; } CoreDebug_Type;
+extern CoreDebug_Type *CoreDebug;
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL<<24)
+typedef struct { union { volatile uint8_t u8; volatile uint16_t u16; volatile uint32_t u32; } PORT[32]; volatile uint32_t TER, TPR, TCR; } ITM_Type;
+extern ITM_Type *ITM;
+#define ITM_TCR_ITMENA_Msk 1UL
+typedef struct { volatile uint32_t ICSR; } SCB_Type;
+extern SCB_Type *SCB;
+#define SCB_ICSR_VECTACTIVE_Msk 0x1FFUL
+#define __NVIC_PRIO_BITS 4U
+static inline uint32_t __get_BASEPRI(void) { return 0; }
+static inline void __set_BASEPRI(uint32_t v) { (void)v; }
+static inline void __set_BASEPRI_MAX(uint32_t v) { (void)v; }
+static inline uint32_t __get_IPSR(void) { return 0; }
+static inline uint32_t __LDREXW(volatile uint32_t *a) { return *a; }
+static inline uint32_t __STREXW(uint32_t v, volatile uint32_t *a) { *a = v; return 0; }
+static inline void __CLREX(void) {}
+static inline void __DMB(void) {}
+static inline void __DSB(void) {}
+static inline void __ISB(void) {}
+uint32_t HAL_RCC_GetHCLKFreq(void);
+uint32_t HAL_GetTick(void);
+void HAL_IncTick(void);
+HAL_StatusTypeDef HAL_Init(void);
+typedef struct { uint32_t OscillatorType, HSEState; struct { uint32_t PLLState, PLLSource, PLLM, PLLN, PLLP, PLLQ; } PLL; } RCC_OscInitTypeDef;
+typedef struct { uint32_t ClockType, SYSCLKSource, AHBCLKDivider, APB1CLKDivider, APB2CLKDivider; } RCC_ClkInitTypeDef;
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *o); HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *c, uint32_t l);
+#define PWR_REGULATOR_VOLTAGE_SCALE1 0
+#define RCC_OSCILLATORTYPE_HSE 1
+#define RCC_HSE_ON 1
+#define RCC_PLL_ON 1
+#define RCC_PLLSOURCE_HSE 1
+#define RCC_PLLP_DIV2 2
+#define RCC_CLOCKTYPE_HCLK 1
+#define RCC_CLOCKTYPE_SYSCLK 2
+#define RCC_CLOCKTYPE_PCLK1 4
+#define RCC_CLOCKTYPE_PCLK2 8
+#define RCC_SYSCLKSOURCE_PLLCLK 2
+#define RCC_SYSCLK_DIV1 0
+#define RCC_HCLK_DIV4 4
+#define RCC_HCLK_DIV2 2
+#define FLASH_LATENCY_5 5
+extern uint32_t SystemCoreClock;
+#define ETH_MACFFR_PAM 0x10U
+#define ETH_MACFFR_HPF 0x400U
+#define ETH_MACFFR_HM 0x4U
+#define ETH_MACA1HR_AE 0x80000000U
+uint32_t __RBIT(uint32_t v);
@@ -0,0 +1,3 @@
+#pragma once
+typedef struct { int x; } RNG_HandleTypeDef;
+HAL_StatusTypeDef HAL_RNG_GenerateRandomNumber(RNG_HandleTypeDef *h, uint32_t *r); HAL_StatusTypeDef HAL_RNG_Init(RNG_HandleTypeDef *h);
@@ -0,0 +1,31 @@
+#pragma once
+#include "FreeRTOS.h"
+typedef void *TaskHandle_t; typedef void (*TaskFunction_t)(void *);
+typedef enum { eRunning, eReady, eBlocked, eSuspended, eDeleted, eInvalid } eTaskState;
+typedef struct { TaskHandle_t xHandle; const char *pcTaskName; UBaseType_t xTaskNumber; eTaskState eCurrentState; UBaseType_t uxCurrentPriority; UBaseType_t uxBasePriority; configRUN_TIME_COUNTER_TYPE ulRunTimeCounter; StackType_t *pxStackBase; uint16_t usStackHighWaterMark; } TaskStatus_t;
+#define taskENTER_CRITICAL() do{}while(0)
+#define taskEXIT_CRITICAL() do{}while(0)
+#define taskDISABLE_INTERRUPTS() do{}while(0)
+#define taskENTER_CRITICAL_FROM_ISR() 0U
+#define taskEXIT_CRITICAL_FROM_ISR(x) (void)(x)
+BaseType_t xTaskCreate(TaskFunction_t f, const char *n, configSTACK_DEPTH_TYPE d, void *a, UBaseType_t p, TaskHandle_t *h);
+TaskHandle_t xTaskCreateStatic(TaskFunction_t f, const char *n, uint32_t d, void *a, UBaseType_t p, StackType_t *s, StaticTask_t *t);
+void vTaskDelay(TickType_t t); void vTaskDelayUntil(TickType_t *p, TickType_t t);
+TickType_t xTaskGetTickCount(void); TickType_t xTaskGetTickCountFromISR(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t t);
+BaseType_t xTaskNotifyGive(TaskHandle_t h);
+void vTaskNotifyGiveFromISR(TaskHandle_t h, BaseType_t *w);
+void vTaskStartScheduler(void); void vTaskGetRunTimeStats(char *b);
+void *pvTaskGetThreadLocalStoragePointer(TaskHandle_t h, BaseType_t i);
+void vTaskSetThreadLocalStoragePointer(TaskHandle_t h, BaseType_t i, void *v);
+UBaseType_t uxTaskGetNumberOfTasks(void);
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *a, UBaseType_t n, configRUN_TIME_COUNTER_TYPE *total);
+void vTaskSuspendAll(void); BaseType_t xTaskResumeAll(void);
+uint32_t ulTaskNotifyTakeIndexed(UBaseType_t i, BaseType_t clear, TickType_t t);
+BaseType_t xTaskNotifyGiveIndexed(TaskHandle_t h, UBaseType_t i);
+void vTaskNotifyGiveIndexedFromISR(TaskHandle_t h, UBaseType_t i, BaseType_t *w);
+typedef struct { BaseType_t a; TickType_t b; } TimeOut_t;
+void vTaskSetTimeOutState(TimeOut_t *t);
+BaseType_t xTaskCheckForTimeOut(TimeOut_t *t, TickType_t *left);
+configRUN_TIME_COUNTER_TYPE ulTaskGetIdleRunTimeCounter(void);
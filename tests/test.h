@@ -0,0 +1,27 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+static int test_failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+		test_failures++; \
+	} \
+} while (0)
+
+/* Runs a test function and prints its result, returns 1 if it failed */
+#define TEST_RUN(fn) test_run(#fn, fn)
+
+static inline int test_run(const char *name, void (*fn)(void))
+{
+	int before = test_failures;
+
+	fn();
+	printf("%-40s %s\n", name, (test_failures == before) ? "ok" : "FAILED");
+	return test_failures != before;
+}
+
+#endif /* TEST_H */
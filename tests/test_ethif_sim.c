@@ -0,0 +1,671 @@
+/* ethif.c against the simulated MAC of eth_sim.h: frames of the peer reach
+ * ethernet_input() intact through the DMA ring, the RX pool and the batches
+ * of the tcpip thread, frames sent by lwIP reach the peer, and every buffer
+ * comes back. The tcpip thread is a message queue run by the test. RX buffers
+ * are smaller than on the target, so full size frames arrive in chains. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TRACE_ENABLE		0
+#define ETH_RX_BUFFER_SIZE	512U
+
+#include "../Src/ethif.c"
+#include "../Src/ethphy.c"
+#include "eth_sim.h"
+#include "test.h"
+
+#define FRAME_MAX		1514U
+#define FRAME_SMALL		60U
+#define FRAME_MID		400U
+#define TEST_MBOX_SIZE		8U
+#define BENCH_FRAMES		200000U
+
+static struct netif s_netif;
+
+/* Pools of ethif.c, bounded as on the target */
+static uint32_t s_rx_pool_cnt;
+static uint32_t s_rx_small_cnt;
+
+void *memp_malloc_pool(const struct memp_desc *d)
+{
+	uint32_t *cnt = (d == &memp_RX_POOL) ? &s_rx_pool_cnt : &s_rx_small_cnt;
+	uint32_t max = (d == &memp_RX_POOL) ? ETH_RX_BUFFER_CNT : ETH_RX_SMALL_BUFFER_CNT;
+
+	if (*cnt == max) {
+		return NULL;
+	}
+	(*cnt)++;
+	return aligned_alloc(32, ((size_t)d->x / max + 31U) & ~(size_t)31U);
+}
+
+void memp_free_pool(const struct memp_desc *d, void *m)
+{
+	uint32_t *cnt = (d == &memp_RX_POOL) ? &s_rx_pool_cnt : &s_rx_small_cnt;
+
+	CHECK(*cnt > 0U);
+	(*cnt)--;
+	free(m);
+}
+
+struct pbuf *pbuf_alloced_custom(pbuf_layer l, u16_t length, pbuf_type type, struct pbuf_custom *p, void *payload_mem, u16_t payload_mem_len)
+{
+	(void)l;
+	(void)type;
+	(void)payload_mem_len;
+	p->pbuf.next = NULL;
+	p->pbuf.payload = payload_mem;
+	p->pbuf.tot_len = length;
+	p->pbuf.len = length;
+	p->pbuf.flags = PBUF_FLAG_IS_CUSTOM;
+	p->pbuf.ref = 1U;
+	return &p->pbuf;
+}
+
+void pbuf_ref(struct pbuf *p)
+{
+	p->ref++;
+}
+
+/* As lwIP: each pbuf of a chain holds a reference on the next one */
+u8_t pbuf_free(struct pbuf *p)
+{
+	u8_t cnt = 0U;
+
+	while (p != NULL) {
+		CHECK(p->ref > 0U);
+		if (--p->ref > 0U) {
+			break;
+		}
+		struct pbuf *q = p->next;
+		CHECK((p->flags & PBUF_FLAG_IS_CUSTOM) != 0U);
+		((struct pbuf_custom *)p)->custom_free_function(p);
+		cnt++;
+		p = q;
+	}
+	return cnt;
+}
+
+u16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, u16_t len, u16_t offset)
+{
+	u16_t copied = 0U;
+
+	CHECK(offset == 0U);
+	for (const struct pbuf *q = p; (q != NULL) && (copied < len); q = q->next) {
+		u16_t n = (u16_t)((q->len < len - copied) ? q->len : len - copied);
+		memcpy((u8_t *)dataptr + copied, q->payload, n);
+		copied = (u16_t)(copied + n);
+	}
+	return copied;
+}
+
+sys_prot_t sys_arch_protect(void)
+{
+	return 0;
+}
+
+void sys_arch_unprotect(sys_prot_t lev)
+{
+	(void)lev;
+}
+
+static int s_core_locked;
+
+void sys_lock_tcpip_core(void)
+{
+	CHECK(!s_core_locked);
+	s_core_locked = 1;
+}
+
+void sys_unlock_tcpip_core(void)
+{
+	CHECK(s_core_locked);
+	s_core_locked = 0;
+}
+
+/* The tcpip thread: messages run in order by tcpip_run() */
+struct tcpip_callback_msg {
+	tcpip_callback_fn fn;
+	void *ctx;
+};
+
+static struct tcpip_callback_msg *s_mbox[TEST_MBOX_SIZE];
+static uint32_t s_mbox_cnt;
+static int s_mbox_blocked;
+
+struct tcpip_callback_msg *tcpip_callbackmsg_new(tcpip_callback_fn fn, void *ctx)
+{
+	struct tcpip_callback_msg *msg = malloc(sizeof(*msg));
+
+	msg->fn = fn;
+	msg->ctx = ctx;
+	return msg;
+}
+
+err_t tcpip_callbackmsg_trycallback(struct tcpip_callback_msg *msg)
+{
+	if (s_mbox_blocked || (s_mbox_cnt == TEST_MBOX_SIZE)) {
+		return ERR_MEM;
+	}
+	s_mbox[s_mbox_cnt++] = msg;
+	return ERR_OK;
+}
+
+err_t tcpip_callbackmsg_trycallback_fromisr(struct tcpip_callback_msg *msg)
+{
+	err_t err = tcpip_callbackmsg_trycallback(msg);
+	return (err == ERR_OK) ? ERR_NEED_SCHED : err;
+}
+
+static uint32_t tcpip_run(void)
+{
+	uint32_t cnt = 0U;
+
+	while (cnt < s_mbox_cnt) {
+		struct tcpip_callback_msg *msg = s_mbox[cnt++];
+		msg->fn(msg->ctx);
+	}
+	s_mbox_cnt = 0U;
+	return cnt;
+}
+
+struct test_sem {
+	UBaseType_t cnt;
+	UBaseType_t max;
+};
+
+SemaphoreHandle_t xSemaphoreCreateCountingStatic(UBaseType_t max, UBaseType_t init, StaticSemaphore_t *b)
+{
+	struct test_sem *sem = (struct test_sem *)b;
+
+	sem->cnt = init;
+	sem->max = max;
+	return sem;
+}
+
+/* Nothing would give the semaphore while the only thread waits for it */
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t t)
+{
+	struct test_sem *sem = s;
+
+	if (sem->cnt == 0U) {
+		CHECK(t != portMAX_DELAY);
+		return pdFALSE;
+	}
+	sem->cnt--;
+	return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s)
+{
+	struct test_sem *sem = s;
+
+	if (sem->cnt == sem->max) {
+		return pdFALSE;
+	}
+	sem->cnt++;
+	return pdTRUE;
+}
+
+/* Task notifications, counted per task */
+static uint32_t s_notify;
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	return &s_notify;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t h)
+{
+	(*(uint32_t *)h)++;
+	return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t h, BaseType_t *w)
+{
+	(void)xTaskNotifyGive(h);
+	*w = pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t t)
+{
+	uint32_t cnt = s_notify;
+
+	(void)t;
+	s_notify = clear ? 0U : ((cnt != 0U) ? cnt - 1U : 0U);
+	return cnt;
+}
+
+void vTaskDelay(TickType_t t)
+{
+	(void)t;
+}
+
+/* Board and MAC registers the driver touches besides the HAL */
+static GPIO_TypeDef s_gpio[5];
+GPIO_TypeDef *GPIOA = &s_gpio[0], *GPIOB = &s_gpio[1], *GPIOC = &s_gpio[2], *GPIOD = &s_gpio[3], *GPIOE = &s_gpio[4];
+static ETH_TypeDef s_eth_regs;
+ETH_TypeDef *ETH = &s_eth_regs;
+
+void HAL_GPIO_Init(GPIO_TypeDef *p, GPIO_InitTypeDef *i)
+{
+	(void)p;
+	(void)i;
+}
+
+void HAL_GPIO_DeInit(GPIO_TypeDef *p, uint32_t pin)
+{
+	(void)p;
+	(void)pin;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *p, uint16_t pin, GPIO_PinState s)
+{
+	(void)p;
+	(void)pin;
+	(void)s;
+}
+
+void HAL_GPIO_EXTI_IRQHandler(uint16_t pin)
+{
+	HAL_GPIO_EXTI_Callback(pin);
+}
+
+uint32_t __RBIT(uint32_t v)
+{
+	uint32_t r = 0U;
+
+	for (uint32_t i = 0U; i < 32U; i++, v >>= 1) {
+		r = (r << 1) | (v & 1U);
+	}
+	return r;
+}
+
+u32_t lwip_htonl(u32_t x)
+{
+	return __builtin_bswap32(x);
+}
+
+err_t etharp_output(struct netif *netif, struct pbuf *q, const ip4_addr_t *ipaddr)
+{
+	(void)ipaddr;
+	return netif->linkoutput(netif, q);
+}
+
+/* Frames handed to the stack, copied out and freed unless held */
+#define RX_LOG_LEN		64U
+
+static struct eth_sim_frame s_rx_log[RX_LOG_LEN];
+static uint32_t s_rx_cnt;
+static struct pbuf *s_rx_held[ETH_RX_BUFFER_CNT + ETH_RX_SMALL_BUFFER_CNT];
+static uint32_t s_rx_held_cnt;
+static int s_rx_hold;
+
+err_t ethernet_input(struct pbuf *p, struct netif *netif)
+{
+	CHECK(netif == &s_netif);
+
+	/* pbuf chain invariants */
+	u16_t left = p->tot_len;
+	for (const struct pbuf *q = p; q != NULL; q = q->next) {
+		CHECK(q->tot_len == left);
+		CHECK((q->next != NULL) || (q->len == q->tot_len));
+		left = (u16_t)(left - q->len);
+	}
+	CHECK(left == 0U);
+
+	struct eth_sim_frame *f = &s_rx_log[s_rx_cnt++ % RX_LOG_LEN];
+	f->len = pbuf_copy_partial(p, f->data, p->tot_len, 0U);
+	if (s_rx_hold) {
+		s_rx_held[s_rx_held_cnt++] = p;
+	} else {
+		pbuf_free(p);
+	}
+	return ERR_OK;
+}
+
+static void release_held(void)
+{
+	for (uint32_t i = 0U; i < s_rx_held_cnt; i++) {
+		pbuf_free(s_rx_held[i]);
+	}
+	s_rx_held_cnt = 0U;
+}
+
+/* Frame n of a test, its bytes count up from n */
+static void make_frame(uint8_t *data, uint16_t len, uint32_t n)
+{
+	for (uint32_t i = 0U; i < len; i++) {
+		data[i] = (uint8_t)(n + i);
+	}
+}
+
+static int is_frame(const struct eth_sim_frame *f, uint16_t len, uint32_t n)
+{
+	uint8_t data[ETH_MAX_PACKET_SIZE];
+
+	make_frame(data, len, n);
+	return (f->len == len) && (memcmp(f->data, data, len) == 0);
+}
+
+static int peer_send(uint16_t len, uint32_t n)
+{
+	uint8_t data[ETH_MAX_PACKET_SIZE];
+
+	make_frame(data, len, n);
+	return eth_sim_peer_send(data, len);
+}
+
+/* The input task: drains the DMA until it has nothing left */
+static uint32_t input_run(void)
+{
+	uint32_t total = 0U;
+	uint32_t cnt;
+
+	eth_sim_dma();
+	do {
+		cnt = ethif_input_batch(&s_netif);
+		total += cnt;
+		(void)tcpip_run();
+		eth_sim_dma();
+	} while (cnt != 0U);
+	return total;
+}
+
+/* All RX buffers are back in the descriptors or the pool */
+static void check_rx_idle(void)
+{
+	struct ethif_rx_pool_stats stats;
+
+	ethif_get_rx_pool_stats(&stats);
+	CHECK(stats.used == ETH_RX_DESC_CNT);
+	CHECK(s_rx_pool_cnt == ETH_RX_DESC_CNT);
+	CHECK(s_rx_small_cnt == 0U);
+}
+
+static void test_init(void)
+{
+	eth_sim_reset();
+	ethmac_init();
+	CHECK(s_phy == &ethphy_ksz8081);
+	CHECK((s_sim.phy[PHY_CONTROL2] & PHY_REF_CLOCK_SELECT_MASK) == PHY_REF_CLOCK_SELECT_25MHZ);
+	CHECK((s_sim.phy[PHY_INTERRUPT_CONTROL] & PHY_LINK_INT_UP_ENABLE) != 0U);
+
+	CHECK(ethernetif_init(&s_netif) == ERR_OK);
+	CHECK(s_sim.started && s_sim.irq_mode && s_sim.irq_enabled);
+	check_rx_idle();
+
+	ethif_wait_rx();
+	CHECK(s_rx_task == &s_notify);
+}
+
+/* Short frames are copied into the small pool, long ones arrive zero-copy in
+ * a chain of RX buffers */
+static void test_rx(void)
+{
+	uint32_t n = s_rx_cnt;
+
+	s_notify = 0U;
+	CHECK(peer_send(FRAME_SMALL, 1U));
+	CHECK(peer_send(FRAME_MAX, 2U));
+	CHECK(peer_send(FRAME_MID, 3U));
+	eth_sim_dma();
+	CHECK(s_notify != 0U);
+
+	(void)input_run();
+	CHECK(s_rx_cnt == n + 3U);
+	CHECK(is_frame(&s_rx_log[n % RX_LOG_LEN], FRAME_SMALL, 1U));
+	CHECK(is_frame(&s_rx_log[(n + 1U) % RX_LOG_LEN], FRAME_MAX, 2U));
+	CHECK(is_frame(&s_rx_log[(n + 2U) % RX_LOG_LEN], FRAME_MID, 3U));
+	check_rx_idle();
+}
+
+/* While the stack holds every RX buffer, frames wait in the MAC. Freeing the
+ * buffers wakes the input task, which rebuilds the descriptors, and all
+ * frames arrive in order. */
+static void test_rx_exhausted(void)
+{
+	const uint32_t sent = ETH_RX_BUFFER_CNT + 4U;
+	uint32_t n = s_rx_cnt;
+	struct ethif_rx_pool_stats stats;
+
+	ethif_get_rx_pool_stats(&stats);
+	uint32_t exhausted = stats.exhausted;
+
+	s_rx_hold = 1;
+	for (uint32_t i = 0U; i < sent; i++) {
+		CHECK(peer_send(FRAME_MID, i));
+		(void)input_run();
+	}
+	CHECK(s_rx_cnt - n < sent);
+	CHECK(RxAllocStatus == RX_ALLOC_ERROR);
+	ethif_get_rx_pool_stats(&stats);
+	CHECK(stats.exhausted > exhausted);
+	CHECK(stats.used == ETH_RX_BUFFER_CNT);
+	CHECK(s_sim.stats.rx_missed == 0U);
+
+	s_rx_hold = 0;
+	s_notify = 0U;
+	release_held();
+	CHECK(RxAllocStatus == RX_ALLOC_OK);
+	CHECK(s_notify != 0U);
+
+	(void)input_run();
+	CHECK(s_rx_cnt - n == sent);
+	for (uint32_t i = 0U; i < sent; i++) {
+		CHECK(is_frame(&s_rx_log[(n + i) % RX_LOG_LEN], FRAME_MID, i));
+	}
+	check_rx_idle();
+}
+
+/* A batch the tcpip mailbox refuses is dropped and its buffers freed */
+static void test_rx_mbox_full(void)
+{
+	uint32_t n = s_rx_cnt;
+
+	CHECK(peer_send(FRAME_MAX, 0U));
+	CHECK(peer_send(FRAME_SMALL, 1U));
+	s_mbox_blocked = 1;
+	CHECK(input_run() == 2U);
+	s_mbox_blocked = 0;
+	CHECK(s_rx_cnt == n);
+	check_rx_idle();
+
+	CHECK(peer_send(FRAME_SMALL, 2U));
+	CHECK(input_run() == 1U);
+	CHECK(is_frame(&s_rx_log[n % RX_LOG_LEN], FRAME_SMALL, 2U));
+}
+
+/* TX pbufs of the test, freed counts the ones released by the driver */
+#define TX_PBUF_CNT		(ETH_TX_DESC_CNT + 2U)
+
+static struct pbuf_custom s_tx_pbuf[TX_PBUF_CNT];
+static uint8_t s_tx_data[ETH_MAX_PACKET_SIZE];
+static uint32_t s_tx_freed;
+
+static void tx_pbuf_free(struct pbuf *p)
+{
+	(void)p;
+	s_tx_freed++;
+}
+
+/* Splits len bytes of frame n over cnt pbufs */
+static struct pbuf *tx_chain(uint16_t len, uint32_t cnt, uint32_t n)
+{
+	uint16_t seg = (uint16_t)(len / cnt);
+
+	make_frame(s_tx_data, len, n);
+	for (uint32_t i = 0U; i < cnt; i++) {
+		struct pbuf *p = &s_tx_pbuf[i].pbuf;
+		s_tx_pbuf[i].custom_free_function = tx_pbuf_free;
+		p->next = (i + 1U < cnt) ? &s_tx_pbuf[i + 1U].pbuf : NULL;
+		p->payload = &s_tx_data[i * seg];
+		p->len = (i + 1U < cnt) ? seg : (uint16_t)(len - i * seg);
+		p->tot_len = (uint16_t)(len - i * seg);
+		p->flags = PBUF_FLAG_IS_CUSTOM;
+		p->ref = 1U;
+	}
+	return &s_tx_pbuf[0].pbuf;
+}
+
+static int peer_is_frame(uint16_t len, uint32_t n)
+{
+	struct eth_sim_frame f;
+
+	f.len = eth_sim_peer_recv(f.data, sizeof(f.data));
+	return is_frame(&f, len, n);
+}
+
+/* The pbuf is held until the DMA has read it, and released by the TX complete
+ * interrupt without a further frame being sent */
+static void test_tx(void)
+{
+	struct pbuf *p = tx_chain(FRAME_MAX, 3U, 7U);
+
+	s_tx_freed = 0U;
+	CHECK(s_netif.linkoutput(&s_netif, p) == ERR_OK);
+	CHECK(p->ref == 2U);
+	CHECK(eth_sim_peer_recv(s_tx_data, 1U) == 0U);
+
+	eth_sim_dma();
+	CHECK(peer_is_frame(FRAME_MAX, 7U));
+	CHECK(p->ref == 2U);
+	CHECK(tcpip_run() == 1U);
+	CHECK(p->ref == 1U);
+	CHECK(s_tx_frames == 0U);
+
+	CHECK(pbuf_free(p) == 3U);
+	CHECK(s_tx_freed == 3U);
+
+	/* Nothing to reclaim once the ring is empty */
+	eth_sim_dma();
+	CHECK(tcpip_run() == 0U);
+}
+
+/* With all descriptors in flight a frame is refused and not held */
+static void test_tx_ring_full(void)
+{
+	struct pbuf *p[ETH_TX_DESC_CNT + 1U];
+
+	s_tx_freed = 0U;
+	make_frame(s_tx_data, FRAME_SMALL, 0U);
+	for (uint32_t i = 0U; i <= ETH_TX_DESC_CNT; i++) {
+		p[i] = &s_tx_pbuf[i].pbuf;
+		*p[i] = (struct pbuf){ .payload = s_tx_data, .tot_len = FRAME_SMALL, .len = FRAME_SMALL,
+				       .flags = PBUF_FLAG_IS_CUSTOM, .ref = 1U };
+		s_tx_pbuf[i].custom_free_function = tx_pbuf_free;
+	}
+
+	for (uint32_t i = 0U; i < ETH_TX_DESC_CNT; i++) {
+		CHECK(s_netif.linkoutput(&s_netif, p[i]) == ERR_OK);
+	}
+	CHECK(s_netif.linkoutput(&s_netif, p[ETH_TX_DESC_CNT]) == ERR_MEM);
+	CHECK(p[ETH_TX_DESC_CNT]->ref == 1U);
+	CHECK(s_tx_frames == ETH_TX_DESC_CNT);
+
+	eth_sim_dma();
+	CHECK(tcpip_run() == 1U);
+	CHECK(s_tx_frames == 0U);
+	for (uint32_t i = 0U; i < ETH_TX_DESC_CNT; i++) {
+		CHECK(p[i]->ref == 1U);
+		CHECK(peer_is_frame(FRAME_SMALL, 0U));
+	}
+	CHECK(s_tx_freed == 0U);
+}
+
+/* A chain longer than the TX ring goes out of the bounce buffer */
+static void test_tx_bounce(void)
+{
+	struct pbuf *p = tx_chain(FRAME_MAX, ETH_TX_DESC_CNT + 2U, 9U);
+
+	CHECK(s_netif.linkoutput(&s_netif, p) == ERR_OK);
+	CHECK(p->ref == 1U);
+	CHECK(s_tx_bounce_busy);
+	/* The buffer is copied, the caller may reuse its pbufs */
+	memset(s_tx_data, 0, sizeof(s_tx_data));
+
+	eth_sim_dma();
+	CHECK(peer_is_frame(FRAME_MAX, 9U));
+	CHECK(tcpip_run() == 1U);
+	CHECK(!s_tx_bounce_busy);
+	CHECK(s_tx_frames == 0U);
+}
+
+/* A link change reported by the PHY interrupt is followed by the MAC, which
+ * keeps its RX buffers across the restart */
+static void test_link_mode(void)
+{
+	CHECK(ethphy_wait_link() == LINK_UNCHANGED);
+
+	eth_sim_phy_set(PHY_CONTROL1, PHY_OPERATION_MODE_10BASE_T);
+	eth_sim_phy_set(PHY_INTERRUPT_STATUS, s_sim.phy[PHY_INTERRUPT_STATUS] | PHY_LINK_INT_UP_OCCURRED);
+	EXTI9_5_IRQHandler();
+	CHECK(ethphy_wait_link() == LINK_UP);
+	CHECK(s_sim.mac_config.Speed == ETH_SPEED_10M);
+	CHECK(s_sim.mac_config.DuplexMode == ETH_HALFDUPLEX_MODE);
+	CHECK(s_sim.started && s_sim.irq_mode);
+	CHECK(!s_core_locked);
+	check_rx_idle();
+
+	uint32_t n = s_rx_cnt;
+	CHECK(peer_send(FRAME_MID, 5U));
+	CHECK(input_run() == 1U);
+	CHECK(is_frame(&s_rx_log[n % RX_LOG_LEN], FRAME_MID, 5U));
+}
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* Frames per second through the driver, host CPU time of the driver paths
+ * and the simulated DMA copies */
+static void test_bench(void)
+{
+	uint32_t n = s_rx_cnt;
+	double start = now_s();
+
+	for (uint32_t i = 0U; i < BENCH_FRAMES; i += ETHIF_RX_BATCH) {
+		for (uint32_t j = 0U; j < ETHIF_RX_BATCH; j++) {
+			(void)peer_send(FRAME_MAX, j);
+		}
+		(void)input_run();
+	}
+	double rx = (double)(s_rx_cnt - n) / (now_s() - start);
+	CHECK(s_rx_cnt - n == BENCH_FRAMES);
+
+	struct pbuf *p = tx_chain(FRAME_MAX, 3U, 0U);
+	start = now_s();
+	for (uint32_t i = 0U; i < BENCH_FRAMES; i++) {
+		(void)s_netif.linkoutput(&s_netif, p);
+		eth_sim_dma();
+		(void)tcpip_run();
+		(void)eth_sim_peer_recv(s_tx_data, 1U);
+	}
+	double tx = (double)BENCH_FRAMES / (now_s() - start);
+	CHECK(p->ref == 1U);
+	check_rx_idle();
+
+	printf("  %u byte frames: %.0f RX frames/s, %.0f TX frames/s\n", FRAME_MAX, rx, tx);
+}
+
+int main(void)
+{
+	int failed = 0;
+
+	failed |= TEST_RUN(test_init);
+	failed |= TEST_RUN(test_rx);
+	failed |= TEST_RUN(test_rx_exhausted);
+	failed |= TEST_RUN(test_rx_mbox_full);
+	failed |= TEST_RUN(test_tx);
+	failed |= TEST_RUN(test_tx_ring_full);
+	failed |= TEST_RUN(test_tx_bounce);
+	failed |= TEST_RUN(test_link_mode);
+	failed |= TEST_RUN(test_bench);
+
+	return failed;
+}
@@ -0,0 +1,102 @@
+/* ethptp_adjust_offset() writes subtracted steps the way the MAC expects them
+ * with digital rollover, and updates the MAC does not take over are reported
+ * as timeouts. The MAC registers are plain memory here: update bits set by
+ * the driver are never cleared, as by a MAC that is not clocked. */
+
+#include <string.h>
+
+#define ETHIF_PTP		1
+
+#include "../Src/ethptp.c"
+#include "test.h"
+
+static ETH_TypeDef s_eth;
+static ETH_HandleTypeDef s_handle = { .Instance = &s_eth };
+
+uint32_t HAL_RCC_GetHCLKFreq(void)
+{
+	return 168000000U;
+}
+
+HAL_StatusTypeDef HAL_ETH_PTP_SetConfig(ETH_HandleTypeDef *h, ETH_PTP_ConfigTypeDef *c)
+{
+	h->Instance->PTPTSCR = (c->TimestampRolloverMode == ENABLE) ? PTPTSCR_TSSSR : 0U;
+	h->Instance->PTPTSAR = c->TimestampAddend;
+	return HAL_OK;
+}
+
+static void reset(uint32_t ptptscr)
+{
+	memset(&s_eth, 0, sizeof(s_eth));
+	CHECK(ethptp_init(&s_handle) == HAL_OK);
+	s_eth.PTPTSCR = ptptscr;
+}
+
+static void test_step_forward(void)
+{
+	reset(PTPTSCR_TSSSR);
+	CHECK(ethptp_adjust_offset(2 * NSEC_PER_SEC + 300) == HAL_TIMEOUT);
+	CHECK(s_eth.PTPTSHUR == 2U);
+	CHECK(s_eth.PTPTSLUR == 300U);
+}
+
+/* With digital rollover the subtracted nanoseconds are written as their
+ * complement to 10^9, as the stmmac driver does */
+static void test_step_back(void)
+{
+	reset(PTPTSCR_TSSSR);
+	CHECK(ethptp_adjust_offset(-(2 * NSEC_PER_SEC + 300)) == HAL_TIMEOUT);
+	CHECK(s_eth.PTPTSHUR == 2U);
+	CHECK(s_eth.PTPTSLUR == (PTPTSLUR_TSUPNS | 999999700U));
+
+	reset(PTPTSCR_TSSSR);
+	(void)ethptp_adjust_offset(-2 * NSEC_PER_SEC);
+	CHECK(s_eth.PTPTSHUR == 2U);
+	CHECK(s_eth.PTPTSLUR == PTPTSLUR_TSUPNS);
+}
+
+/* With binary rollover the sign bit alone is enough */
+static void test_step_back_binary(void)
+{
+	reset(0U);
+	(void)ethptp_adjust_offset(-(2 * NSEC_PER_SEC + 300));
+	CHECK(s_eth.PTPTSHUR == 2U);
+	CHECK(s_eth.PTPTSLUR == (PTPTSLUR_TSUPNS | 300U));
+}
+
+/* A step still in progress is not overwritten */
+static void test_step_busy(void)
+{
+	reset(PTPTSCR_TSSSR | PTPTSCR_TSSTU);
+	s_eth.PTPTSHUR = 7U;
+	CHECK(ethptp_adjust_offset(-300) == HAL_TIMEOUT);
+	CHECK(s_eth.PTPTSHUR == 7U);
+	CHECK(s_eth.PTPTSLUR == 0U);
+}
+
+static void test_adjust_freq(void)
+{
+	reset(PTPTSCR_TSSSR);
+	uint32_t addend = s_eth.PTPTSAR;
+
+	CHECK(ethptp_adjust_freq(-ETHPTP_MAX_PPB) == HAL_OK);
+	CHECK(s_eth.PTPTSAR == addend - addend / 2000U);
+	CHECK((s_eth.PTPTSCR & PTPTSCR_TTSARU) != 0U);
+
+	/* The MAC has not loaded the previous addend yet */
+	CHECK(ethptp_adjust_freq(0) == HAL_TIMEOUT);
+	CHECK(s_eth.PTPTSAR == addend - addend / 2000U);
+}
+
+int main(void)
+{
+	int failed = 0;
+
+	failed |= TEST_RUN(test_step_forward);
+	failed |= TEST_RUN(test_step_back);
+	failed |= TEST_RUN(test_step_back_binary);
+	failed |= TEST_RUN(test_step_busy);
+	failed |= TEST_RUN(test_adjust_freq);
+
+	return failed;
+}
@@ -0,0 +1,170 @@
+/* The FreeRTOS queue backend of sys_mbox_t under the stress test and the
+ * benchmark of test_mbox_ring.c. The queue is emulated with a mutex and two
+ * condition variables, like the critical section and the waiter lists of a
+ * FreeRTOS queue. */
+
+#include <string.h>
+
+#define TRACE_ENABLE			0
+#define LWIP_FREERTOS_MBOX_RING		0
+
+#include "../Src/sys_arch.c"
+#include "mbox_test.h"
+
+struct test_queue {
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+	UBaseType_t size;
+	UBaseType_t cnt;
+	UBaseType_t head;
+	void *item[];
+};
+
+/* The handle of a static queue is its StaticQueue_t, which holds the emulated
+ * queue */
+QueueHandle_t xQueueCreateStatic(UBaseType_t l, UBaseType_t s, uint8_t *b, StaticQueue_t *q)
+{
+	(void)b;
+	struct test_queue *queue = calloc(1, sizeof(*queue) + l * sizeof(void *));
+
+	CHECK(s == sizeof(void *));
+	pthread_mutex_init(&queue->lock, NULL);
+	pthread_cond_init(&queue->not_empty, NULL);
+	pthread_cond_init(&queue->not_full, NULL);
+	queue->size = l;
+	memcpy(q, &queue, sizeof(queue));
+	return q;
+}
+
+static struct test_queue *test_queue(QueueHandle_t q)
+{
+	struct test_queue *queue;
+
+	memcpy(&queue, q, sizeof(queue));
+	return queue;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+	free(test_queue(q));
+}
+
+/* Waits for cond for t ticks, returns 0 on timeout */
+static int queue_wait(struct test_queue *queue, pthread_cond_t *cond, TickType_t t)
+{
+	if (t == 0U) {
+		return 0;
+	}
+	if (t == portMAX_DELAY) {
+		pthread_cond_wait(cond, &queue->lock);
+		return 1;
+	}
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	uint64_t end = (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec + (uint64_t)t * 1000000U;
+	ts.tv_sec = (time_t)(end / 1000000000U);
+	ts.tv_nsec = (long)(end % 1000000000U);
+	return pthread_cond_timedwait(cond, &queue->lock, &ts) == 0;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t q, const void *i, TickType_t t)
+{
+	struct test_queue *queue = test_queue(q);
+	BaseType_t ret = pdTRUE;
+
+	pthread_mutex_lock(&queue->lock);
+	while (queue->cnt == queue->size) {
+		if (!queue_wait(queue, &queue->not_full, t)) {
+			ret = errQUEUE_FULL;
+			break;
+		}
+	}
+	if (ret == pdTRUE) {
+		memcpy(&queue->item[(queue->head + queue->cnt) % queue->size], i, sizeof(void *));
+		queue->cnt++;
+		pthread_cond_signal(&queue->not_empty);
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return ret;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *i, TickType_t t)
+{
+	struct test_queue *queue = test_queue(q);
+	BaseType_t ret = pdTRUE;
+
+	pthread_mutex_lock(&queue->lock);
+	while (queue->cnt == 0U) {
+		if (!queue_wait(queue, &queue->not_empty, t)) {
+			ret = errQUEUE_EMPTY;
+			break;
+		}
+	}
+	if (ret == pdTRUE) {
+		memcpy(i, &queue->item[queue->head], sizeof(void *));
+		queue->head = (queue->head + 1U) % queue->size;
+		queue->cnt--;
+		pthread_cond_signal(&queue->not_full);
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return ret;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+	struct test_queue *queue = test_queue(q);
+
+	pthread_mutex_lock(&queue->lock);
+	UBaseType_t cnt = queue->cnt;
+	pthread_mutex_unlock(&queue->lock);
+	return cnt;
+}
+
+static void test_full(void)
+{
+	sys_mbox_t mbox;
+
+	CHECK(sys_mbox_new(&mbox, MBOX_TEST_SIZE) == ERR_OK);
+	mbox_full(&mbox, MBOX_TEST_SIZE);
+	sys_mbox_free(&mbox);
+}
+
+static void test_stress(void)
+{
+	sys_mbox_t mbox;
+
+	CHECK(sys_mbox_new(&mbox, MBOX_TEST_SIZE) == ERR_OK);
+	mbox_stress(&mbox);
+	sys_mbox_free(&mbox);
+}
+
+static void test_timeout(void)
+{
+	sys_mbox_t mbox;
+
+	CHECK(sys_mbox_new(&mbox, MBOX_TEST_SIZE) == ERR_OK);
+	mbox_timeout(&mbox);
+	sys_mbox_free(&mbox);
+}
+
+static void test_bench(void)
+{
+	sys_mbox_t mbox;
+
+	CHECK(sys_mbox_new(&mbox, MBOX_BENCH_SIZE) == ERR_OK);
+	mbox_bench(&mbox, "queue");
+	sys_mbox_free(&mbox);
+}
+
+int main(void)
+{
+	int failed = 0;
+
+	failed |= TEST_RUN(test_full);
+	failed |= TEST_RUN(test_stress);
+	failed |= TEST_RUN(test_timeout);
+	failed |= TEST_RUN(test_bench);
+
+	return failed;
+}
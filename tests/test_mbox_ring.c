@@ -0,0 +1,88 @@
+/* The lock-free ring backend of sys_mbox_t delivers every message exactly once
+ * and in the order of its producer, with several producers racing for the
+ * slots of a full ring and across the wrap of the head and tail counters. */
+
+#include <string.h>
+
+#define TRACE_ENABLE			0
+#define LWIP_FREERTOS_MBOX_RING		1
+
+#include "../Src/sys_arch.c"
+#include "mbox_test.h"
+
+/* Moves an empty ring to pos, as if pos messages had passed through it */
+static void ring_rebase(sys_mbox_t *mbox, u32_t pos)
+{
+	struct mbox_ring *ring = mbox->mbx;
+
+	ring->head = pos;
+	ring->tail = pos;
+	for (u32_t i = 0U; i <= ring->mask; i++) {
+		ring->slot[(pos + i) & ring->mask].seq = pos + i;
+	}
+}
+
+static void test_full(void)
+{
+	sys_mbox_t mbox;
+
+	CHECK(sys_mbox_new(&mbox, MBOX_TEST_SIZE) == ERR_OK);
+	mbox_full(&mbox, MBOX_TEST_SIZE);
+	sys_mbox_free(&mbox);
+}
+
+/* The counters wrap within the first few thousand messages */
+static void test_wrap(void)
+{
+	sys_mbox_t mbox;
+
+	CHECK(sys_mbox_new(&mbox, MBOX_TEST_SIZE) == ERR_OK);
+	ring_rebase(&mbox, UINT32_MAX - 3U);
+	mbox_full(&mbox, MBOX_TEST_SIZE);
+	CHECK(((struct mbox_ring *)mbox.mbx)->head < 16U);
+
+	ring_rebase(&mbox, UINT32_MAX - 1000U);
+	mbox_stress(&mbox);
+	sys_mbox_free(&mbox);
+}
+
+static void test_stress(void)
+{
+	sys_mbox_t mbox;
+
+	CHECK(sys_mbox_new(&mbox, MBOX_TEST_SIZE) == ERR_OK);
+	mbox_stress(&mbox);
+	sys_mbox_free(&mbox);
+}
+
+static void test_timeout(void)
+{
+	sys_mbox_t mbox;
+
+	CHECK(sys_mbox_new(&mbox, MBOX_TEST_SIZE) == ERR_OK);
+	mbox_timeout(&mbox);
+	CHECK(((struct mbox_ring *)mbox.mbx)->waiter == NULL);
+	sys_mbox_free(&mbox);
+}
+
+static void test_bench(void)
+{
+	sys_mbox_t mbox;
+
+	CHECK(sys_mbox_new(&mbox, MBOX_BENCH_SIZE) == ERR_OK);
+	mbox_bench(&mbox, "ring");
+	sys_mbox_free(&mbox);
+}
+
+int main(void)
+{
+	int failed = 0;
+
+	failed |= TEST_RUN(test_full);
+	failed |= TEST_RUN(test_wrap);
+	failed |= TEST_RUN(test_stress);
+	failed |= TEST_RUN(test_timeout);
+	failed |= TEST_RUN(test_bench);
+
+	return failed;
+}
@@ -0,0 +1,194 @@
+/* Captured frames are written out whole: RX frames from the pool buffers they
+ * arrived in, held until pcap_drain(), TX frames from their copy. Replay
+ * injects complete records only. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ETHIF_PCAP		1
+
+#include "../Src/pcap.c"
+#include "test.h"
+
+#define FRAME_LEN		1500U
+#define SEG_LEN			600U
+
+/* References held on the pool buffers of the test */
+static int s_refs;
+
+u32_t sys_now(void)
+{
+	return 0U;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+	return 0U;
+}
+
+void vTaskDelayUntil(TickType_t *p, TickType_t t)
+{
+	*p += t;
+}
+
+void pbuf_ref(struct pbuf *p)
+{
+	p->ref++;
+	s_refs++;
+}
+
+u8_t pbuf_free(struct pbuf *p)
+{
+	if (p->payload == p + 1) {
+		free(p);
+	} else {
+		p->ref--;
+		s_refs--;
+	}
+	return 1U;
+}
+
+u16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, u16_t len, u16_t offset)
+{
+	u16_t copied = 0U;
+
+	CHECK(offset == 0U);
+	for (const struct pbuf *q = p; (q != NULL) && (copied < len); q = q->next) {
+		u16_t n = (u16_t)((q->len < len - copied) ? q->len : len - copied);
+		memcpy((u8_t *)dataptr + copied, q->payload, n);
+		copied = (u16_t)(copied + n);
+	}
+	return copied;
+}
+
+/* Injected frames, as the RX pool would hand them out */
+static uint32_t s_injected;
+static uint32_t s_injected_len;
+
+struct pbuf *ethif_rx_pbuf(const void *data, uint16_t len)
+{
+	(void)data;
+	struct pbuf *p = calloc(1, sizeof(struct pbuf));
+
+	p->payload = p + 1;
+	p->len = len;
+	p->tot_len = len;
+	return p;
+}
+
+static err_t netif_input(struct pbuf *p, struct netif *inp)
+{
+	(void)inp;
+	s_injected++;
+	s_injected_len += p->tot_len;
+	pbuf_free(p);
+	return ERR_OK;
+}
+
+/* In-memory capture file */
+static uint8_t s_file[4 * (FRAME_LEN + 64U)];
+static size_t s_file_len;
+
+static void file_write(const void *data, size_t len)
+{
+	CHECK(s_file_len + len <= sizeof(s_file));
+	if (s_file_len + len <= sizeof(s_file)) {
+		memcpy(&s_file[s_file_len], data, len);
+		s_file_len += len;
+	}
+}
+
+static uint8_t s_frame[FRAME_LEN];
+
+static void check_frame(const uint8_t *rec)
+{
+	struct pcap_rec_hdr hdr;
+
+	memcpy(&hdr, rec, sizeof(hdr));
+	CHECK(hdr.incl_len == FRAME_LEN);
+	CHECK(hdr.orig_len == FRAME_LEN);
+	CHECK(memcmp(rec + sizeof(hdr), s_frame, FRAME_LEN) == 0);
+}
+
+/* An RX frame of two segments, the first one advanced past its Ethernet
+ * header by the stack before it is written */
+static void test_capture(void)
+{
+	struct pbuf rx[2] = {
+		{ .next = &rx[1], .payload = s_frame, .tot_len = FRAME_LEN, .len = SEG_LEN, .ref = 1U },
+		{ .payload = s_frame + SEG_LEN, .tot_len = FRAME_LEN - SEG_LEN, .len = FRAME_LEN - SEG_LEN, .ref = 1U },
+	};
+	struct pbuf tx = { .payload = s_frame, .tot_len = FRAME_LEN, .len = FRAME_LEN, .ref = 1U };
+
+	for (uint32_t i = 0U; i < FRAME_LEN; i++) {
+		s_frame[i] = (uint8_t)(i * 7U);
+	}
+
+	pcap_tap(PCAP_RX, &rx[0]);
+	CHECK(s_refs == 1);
+	rx[0].payload = s_frame + 14;
+	rx[0].len = SEG_LEN - 14U;
+	rx[0].tot_len = FRAME_LEN - 14U;
+
+	pcap_tap(PCAP_TX, &tx);
+	CHECK(tx.ref == 1U);
+
+	CHECK(pcap_drain(file_write) == 2U);
+	CHECK(s_refs == 0);
+	CHECK(s_file_len == sizeof(struct pcap_file_hdr) + 2U * (sizeof(struct pcap_rec_hdr) + FRAME_LEN));
+	check_frame(&s_file[sizeof(struct pcap_file_hdr)]);
+	check_frame(&s_file[sizeof(struct pcap_file_hdr) + sizeof(struct pcap_rec_hdr) + FRAME_LEN]);
+}
+
+/* Pending RX frames hold at most PCAP_RING_SIZE pool buffers */
+static void test_pin_bound(void)
+{
+	struct pbuf rx = { .payload = s_frame, .tot_len = 60U, .len = 60U, .ref = 1U };
+
+	uint32_t dropped = pcap_dropped();
+	for (uint32_t i = 0U; i < 2U * PCAP_RING_SIZE; i++) {
+		pcap_tap(PCAP_RX, &rx);
+	}
+	CHECK(s_refs == (int)PCAP_RING_SIZE);
+	CHECK(pcap_dropped() == dropped + PCAP_RING_SIZE);
+
+	s_file_len = 0U;
+	CHECK(pcap_drain(file_write) == PCAP_RING_SIZE);
+	CHECK(s_refs == 0);
+}
+
+static void put_rec(size_t *len, uint32_t incl_len, uint32_t orig_len)
+{
+	struct pcap_rec_hdr hdr = { .incl_len = incl_len, .orig_len = orig_len };
+
+	memcpy(&s_file[*len], &hdr, sizeof(hdr));
+	*len += sizeof(hdr) + incl_len;
+}
+
+static void test_replay_truncated(void)
+{
+	struct pcap_file_hdr hdr = { .magic = PCAP_MAGIC, .snaplen = 128U, .network = PCAP_LINKTYPE_ETHERNET };
+	struct netif netif = { .input = netif_input };
+	size_t len = sizeof(hdr);
+
+	memcpy(s_file, &hdr, sizeof(hdr));
+	put_rec(&len, 60U, 60U);
+	put_rec(&len, 128U, FRAME_LEN);
+	put_rec(&len, 1000U, 1000U);
+
+	CHECK(pcap_replay(&netif, s_file, len, 0) == ERR_OK);
+	CHECK(s_injected == 2U);
+	CHECK(s_injected_len == 1060U);
+	CHECK(pcap_truncated() == 1U);
+}
+
+int main(void)
+{
+	int failed = 0;
+
+	failed |= TEST_RUN(test_capture);
+	failed |= TEST_RUN(test_pin_bound);
+	failed |= TEST_RUN(test_replay_truncated);
+
+	return failed;
+}
@@ -0,0 +1,393 @@
+/* The PTP slave follows a master over scripted Sync, Follow_Up, Delay_Req and
+ * Delay_Resp exchanges. The MAC clock is simulated: it drifts against the
+ * master, and the steps and frequency adjustments of the servo act on it. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ETHIF_PTP		1
+
+#include "../Src/ptp.c"
+#include "test.h"
+
+#define ROUNDS			120U
+#define PATH_DELAY_NS		5000
+#define DRIFT_PPB		20000
+
+static const u8_t s_master_id[PTP_PORT_ID_LEN] = { 0x00, 0x1B, 0x19, 0xFF, 0xFE, 0x00, 0x00, 0x01, 0x00, 0x01 };
+static const u8_t s_other_id[PTP_PORT_ID_LEN] = { 0x00, 0x1B, 0x19, 0xFF, 0xFE, 0x00, 0x00, 0x02, 0x00, 0x01 };
+
+/* Master time and the simulated MAC clock, in ns */
+static int64_t s_master_ns;
+static int64_t s_clock_ns;
+static int32_t s_freq_ppb;
+static int64_t s_drift_ppb;
+static HAL_StatusTypeDef s_adjust_status;
+
+/* Receive time of the frame being delivered */
+static int64_t s_rx_ns;
+
+/* Delay_Req sent by the slave and when it left */
+static u8_t s_delay_req[PTP_EVENT_MSG_LEN];
+static int s_delay_req_sent;
+static int64_t s_t3_master_ns;
+
+static struct udp_pcb *s_pcbs[2];
+static udp_recv_fn s_recv[2];
+static sys_timeout_handler s_tick;
+
+/* Simulated MAC clock */
+
+HAL_StatusTypeDef ethptp_get_time(struct ethptp_time *time)
+{
+	time->sec = (uint32_t)(s_clock_ns / NSEC_PER_SEC);
+	time->nsec = (uint32_t)(s_clock_ns % NSEC_PER_SEC);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef ethptp_adjust_offset(int64_t ns)
+{
+	if (s_adjust_status == HAL_OK) {
+		s_clock_ns += ns;
+	}
+	return s_adjust_status;
+}
+
+HAL_StatusTypeDef ethptp_adjust_freq(int32_t ppb)
+{
+	if (s_adjust_status == HAL_OK) {
+		s_freq_ppb = ppb;
+	}
+	return s_adjust_status;
+}
+
+int ethif_rx_timestamp(const struct pbuf *p, struct ethptp_time *ts)
+{
+	(void)p;
+	ts->sec = (uint32_t)(s_rx_ns / NSEC_PER_SEC);
+	ts->nsec = (uint32_t)(s_rx_ns % NSEC_PER_SEC);
+	return 1;
+}
+
+/* Both clocks run for ns of master time */
+static void advance(int64_t ns)
+{
+	s_master_ns += ns;
+	s_clock_ns += ns + ns * (s_drift_ppb + s_freq_ppb) / NSEC_PER_SEC;
+}
+
+/* lwIP */
+
+u16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, u16_t len, u16_t offset)
+{
+	if (offset >= p->len) {
+		return 0U;
+	}
+	if (len > p->len - offset) {
+		len = (u16_t)(p->len - offset);
+	}
+	memcpy(dataptr, (const u8_t *)p->payload + offset, len);
+	return len;
+}
+
+struct pbuf *pbuf_alloc(pbuf_layer l, u16_t length, pbuf_type type)
+{
+	(void)l;
+	(void)type;
+	struct pbuf *p = calloc(1, sizeof(struct pbuf) + length);
+
+	p->payload = p + 1;
+	p->tot_len = length;
+	p->len = length;
+	p->ref = 1U;
+	return p;
+}
+
+/* Received pbufs live on the stack of the test, sent ones are allocated */
+u8_t pbuf_free(struct pbuf *p)
+{
+	if (p->payload == p + 1) {
+		free(p);
+	}
+	return 1U;
+}
+
+err_t igmp_joingroup_netif(struct netif *n, const ip4_addr_t *g)
+{
+	(void)n;
+	(void)g;
+	return ERR_OK;
+}
+
+struct udp_pcb *udp_new_ip_type(u8_t type)
+{
+	(void)type;
+	return calloc(1, 1);
+}
+
+err_t udp_bind(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port)
+{
+	(void)ipaddr;
+	s_pcbs[port == PTP_GENERAL_PORT] = pcb;
+	return ERR_OK;
+}
+
+void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *recv_arg)
+{
+	(void)recv_arg;
+	s_recv[pcb == s_pcbs[1]] = recv;
+}
+
+/* The MAC timestamps the Delay_Req as it leaves, the driver reports it from
+ * HAL_ETH_ReleaseTxPacket() */
+err_t udp_sendto(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *dst_ip, u16_t dst_port)
+{
+	(void)dst_ip;
+	struct ethptp_time t3;
+
+	CHECK(pcb == s_pcbs[0]);
+	CHECK(dst_port == PTP_EVENT_PORT);
+	CHECK(pbuf_copy_partial(p, s_delay_req, sizeof(s_delay_req), 0U) == sizeof(s_delay_req));
+	s_delay_req_sent = 1;
+	s_t3_master_ns = s_master_ns;
+
+	ethptp_get_time(&t3);
+	ptp_tx_timestamp(p, 0U, &t3);
+	return ERR_OK;
+}
+
+void sys_timeout(u32_t msecs, sys_timeout_handler handler, void *arg)
+{
+	(void)msecs;
+	(void)arg;
+	s_tick = handler;
+}
+
+/* Messages of the master */
+
+static void put_be32(u8_t *b, u32_t v)
+{
+	b[0] = (u8_t)(v >> 24);
+	b[1] = (u8_t)(v >> 16);
+	b[2] = (u8_t)(v >> 8);
+	b[3] = (u8_t)v;
+}
+
+static void put_timestamp(u8_t *b, int64_t ns)
+{
+	uint64_t sec = (uint64_t)(ns / NSEC_PER_SEC);
+
+	put_be16(b, (u16_t)(sec >> 32));
+	put_be32(b + 2, (u32_t)sec);
+	put_be32(b + 6, (u32_t)(ns % NSEC_PER_SEC));
+}
+
+static void put_header(u8_t *msg, u8_t type, u16_t len, u16_t seq, const u8_t *source)
+{
+	memset(msg, 0, len);
+	msg[PTP_OFF_TYPE] = type;
+	msg[PTP_OFF_VERSION] = PTP_VERSION;
+	put_be16(&msg[PTP_OFF_LENGTH], len);
+	msg[PTP_OFF_DOMAIN] = PTP_DOMAIN;
+	memcpy(&msg[PTP_OFF_SOURCE], source, PTP_PORT_ID_LEN);
+	put_be16(&msg[PTP_OFF_SEQ], seq);
+}
+
+static void deliver(int general, u8_t *msg, u16_t len)
+{
+	struct pbuf p = { .payload = msg, .tot_len = len, .len = len, .ref = 1U };
+
+	s_recv[general](NULL, s_pcbs[general], &p, NULL, general ? PTP_GENERAL_PORT : PTP_EVENT_PORT);
+}
+
+/* Sends a Sync at the current master time, followed by its Follow_Up if
+ * two_step, and lets it take the path delay to the slave */
+static void send_sync(const u8_t *source, u16_t seq, int two_step, u16_t follow_up_seq)
+{
+	u8_t msg[PTP_EVENT_MSG_LEN];
+	int64_t t1 = s_master_ns;
+
+	put_header(msg, PTP_MSG_SYNC, sizeof(msg), seq, source);
+	if (two_step) {
+		msg[PTP_OFF_FLAGS] = PTP_FLAG_TWO_STEP;
+	} else {
+		put_timestamp(&msg[PTP_OFF_TIMESTAMP], t1);
+	}
+	advance(PATH_DELAY_NS);
+	s_rx_ns = s_clock_ns;
+	deliver(0, msg, sizeof(msg));
+
+	if (two_step) {
+		put_header(msg, PTP_MSG_FOLLOW_UP, sizeof(msg), follow_up_seq, source);
+		put_timestamp(&msg[PTP_OFF_TIMESTAMP], t1);
+		deliver(1, msg, sizeof(msg));
+	}
+}
+
+/* Runs the Delay_Req timer and answers the request like the master,
+ * requester is copied from the request unless given */
+static void delay_exchange(const u8_t *source, const u8_t *requester)
+{
+	u8_t msg[PTP_DELAY_RESP_LEN];
+
+	s_delay_req_sent = 0;
+	s_tick(NULL);
+	if (!s_delay_req_sent) {
+		return;
+	}
+	advance(PATH_DELAY_NS);
+
+	put_header(msg, PTP_MSG_DELAY_RESP, sizeof(msg), get_be16(&s_delay_req[PTP_OFF_SEQ]), source);
+	put_timestamp(&msg[PTP_OFF_TIMESTAMP], s_t3_master_ns + PATH_DELAY_NS);
+	memcpy(&msg[PTP_OFF_REQUESTER], (requester != NULL) ? requester : &s_delay_req[PTP_OFF_SOURCE], PTP_PORT_ID_LEN);
+	deliver(1, msg, sizeof(msg));
+}
+
+/* One Sync interval of a two-step master */
+static void run_round(u16_t seq)
+{
+	send_sync(s_master_id, seq, 1, seq);
+	advance(100000000);
+	delay_exchange(s_master_id, NULL);
+	advance(NSEC_PER_SEC - 100000000 - 2 * PATH_DELAY_NS);
+}
+
+/* A fresh slave whose clock starts at 0 while the master is at 1000 s */
+static void reset(int64_t drift_ppb)
+{
+	static struct netif netif = { .hwaddr = { 0x00, 0x80, 0xE1, 0x00, 0x00, 0x01 } };
+
+	s_have_master = 0U;
+	s_sync_wait = 0U;
+	s_ms_valid = 0U;
+	s_t3_valid = 0U;
+	s_path_delay = 0;
+	s_integral = 0;
+	memset(&s_stats, 0, sizeof(s_stats));
+
+	s_master_ns = 1000 * NSEC_PER_SEC;
+	s_clock_ns = 0;
+	s_freq_ppb = 0;
+	s_drift_ppb = drift_ppb;
+	s_adjust_status = HAL_OK;
+	ptp_init(&netif);
+}
+
+static int64_t clock_error(void)
+{
+	return s_clock_ns - s_master_ns;
+}
+
+/* The first Sync steps the clock to the master, less the path delay not
+ * measured yet */
+static void test_step(void)
+{
+	reset(0);
+	send_sync(s_master_id, 1U, 1, 1U);
+
+	CHECK(s_stats.steps == 1U);
+	CHECK(s_stats.syncs == 1U);
+	CHECK(llabs(clock_error() + PATH_DELAY_NS) <= 1);
+	CHECK(memcmp(s_stats.master, s_master_id, PTP_PORT_ID_LEN) == 0);
+}
+
+/* The servo takes out the drift of the clock and the path delay is measured */
+static void test_converge(void)
+{
+	reset(DRIFT_PPB);
+	for (u16_t seq = 1U; seq <= ROUNDS; seq++) {
+		run_round(seq);
+	}
+
+	printf("  offset %ld ns, path delay %ld ns, freq %ld ppb\n",
+	       (long)s_stats.offset_ns, (long)s_stats.path_delay_ns, (long)s_stats.freq_ppb);
+	CHECK(s_stats.steps == 1U);
+	CHECK(s_stats.syncs == ROUNDS);
+	CHECK(s_stats.delay_resps == ROUNDS);
+	CHECK(s_stats.errors == 0U);
+	CHECK(abs(s_stats.path_delay_ns - PATH_DELAY_NS) <= 50);
+	CHECK(abs(s_stats.offset_ns) <= 50);
+	CHECK(abs(s_stats.freq_ppb + DRIFT_PPB) <= 200);
+	CHECK(llabs(clock_error()) <= 200);
+}
+
+/* A one-step master carries t1 in the Sync itself */
+static void test_one_step(void)
+{
+	reset(0);
+	send_sync(s_master_id, 1U, 0, 0U);
+	CHECK(s_stats.syncs == 1U);
+	CHECK(s_stats.steps == 1U);
+
+	advance(NSEC_PER_SEC);
+	send_sync(s_master_id, 2U, 0, 0U);
+	CHECK(s_stats.syncs == 2U);
+	CHECK(s_stats.steps == 1U);
+	/* The step also took out the path delay, which is not measured yet */
+	CHECK(s_stats.offset_ns == 0);
+}
+
+/* Messages of other masters, and for other exchanges, leave the servo alone */
+static void test_ignored(void)
+{
+	reset(0);
+	run_round(1U);
+	run_round(2U);
+	CHECK(s_stats.syncs == 2U);
+	CHECK(s_stats.delay_resps == 2U);
+
+	/* Follow_Up of another Sync */
+	send_sync(s_master_id, 3U, 1, 4U);
+	CHECK(s_stats.syncs == 2U);
+
+	/* Sync of another master */
+	send_sync(s_other_id, 5U, 0, 0U);
+	CHECK(s_stats.syncs == 2U);
+	CHECK(memcmp(s_stats.master, s_master_id, PTP_PORT_ID_LEN) == 0);
+
+	/* Delay_Resp to another slave, or from another master */
+	delay_exchange(s_master_id, s_other_id);
+	CHECK(s_stats.delay_resps == 2U);
+	delay_exchange(s_other_id, NULL);
+	CHECK(s_stats.delay_resps == 2U);
+
+	run_round(6U);
+	CHECK(s_stats.syncs == 3U);
+	CHECK(s_stats.delay_resps == 3U);
+	CHECK(s_stats.steps == 1U);
+}
+
+/* Adjustments the MAC did not take over are counted and retried */
+static void test_adjust_error(void)
+{
+	reset(DRIFT_PPB);
+	s_adjust_status = HAL_TIMEOUT;
+	send_sync(s_master_id, 1U, 1, 1U);
+	CHECK(s_stats.steps == 0U);
+	CHECK(s_stats.errors == 1U);
+
+	s_adjust_status = HAL_OK;
+	advance(NSEC_PER_SEC);
+	send_sync(s_master_id, 2U, 1, 2U);
+	CHECK(s_stats.steps == 1U);
+
+	advance(NSEC_PER_SEC);
+	s_adjust_status = HAL_TIMEOUT;
+	send_sync(s_master_id, 3U, 1, 3U);
+	CHECK(s_stats.errors == 2U);
+	CHECK(s_stats.freq_ppb == 0);
+	CHECK(s_freq_ppb == 0);
+}
+
+int main(void)
+{
+	int failed = 0;
+
+	failed |= TEST_RUN(test_step);
+	failed |= TEST_RUN(test_converge);
+	failed |= TEST_RUN(test_one_step);
+	failed |= TEST_RUN(test_ignored);
+	failed |= TEST_RUN(test_adjust_error);
+
+	return failed;
+}
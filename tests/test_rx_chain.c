@@ -0,0 +1,197 @@
+/* HAL_ETH_RxLinkCallback() chains the buffers of a frame in constant time:
+ * only the head and the appended buffer are touched per descriptor, and
+ * rx_chain_fixup() sets tot_len once the frame is complete. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <x86intrin.h>
+
+#define TRACE_ENABLE		0
+
+#include "../Src/ethif.c"
+#include "test.h"
+
+#define CHAIN_MAX		256U
+#define SEG_LEN			60U
+
+void *memp_malloc_pool(const struct memp_desc *d)
+{
+	(void)d;
+	return aligned_alloc(32, (sizeof(RxBuff_t) + 31U) & ~31U);
+}
+
+void memp_free_pool(const struct memp_desc *d, void *m)
+{
+	(void)d;
+	free(m);
+}
+
+struct pbuf *pbuf_alloced_custom(pbuf_layer l, u16_t length, pbuf_type type, struct pbuf_custom *p, void *payload_mem, u16_t payload_mem_len)
+{
+	(void)l;
+	(void)type;
+	(void)payload_mem_len;
+	p->pbuf.next = NULL;
+	p->pbuf.payload = payload_mem;
+	p->pbuf.tot_len = length;
+	p->pbuf.len = length;
+	p->pbuf.flags = PBUF_FLAG_IS_CUSTOM;
+	p->pbuf.ref = 1U;
+	return &p->pbuf;
+}
+
+sys_prot_t sys_arch_protect(void)
+{
+	return 0;
+}
+
+void sys_arch_unprotect(sys_prot_t lev)
+{
+	(void)lev;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t h)
+{
+	(void)h;
+	return pdPASS;
+}
+
+static uint8_t *s_buff[CHAIN_MAX];
+
+static void alloc_buffers(uint32_t cnt)
+{
+	for (uint32_t i = 0U; i < cnt; i++) {
+		HAL_ETH_RxAllocateCallback(&s_buff[i]);
+		CHECK(s_buff[i] != NULL);
+	}
+}
+
+static void free_buffers(uint32_t cnt)
+{
+	for (uint32_t i = 0U; i < cnt; i++) {
+		free(s_buff[i] - offsetof(RxBuff_t, buff));
+	}
+}
+
+/* Buffer i of a frame is received with i + SEG_LEN bytes, so misplaced
+ * lengths show up in the sums */
+static uint16_t seg_len(uint32_t i)
+{
+	return (uint16_t)(SEG_LEN + i);
+}
+
+/* Feeds a frame of cnt descriptors like HAL_ETH_ReadData() does */
+static void check_frame(uint32_t cnt)
+{
+	void *start = NULL;
+	void *end = NULL;
+	uint32_t sum = 0U;
+
+	alloc_buffers(cnt);
+	for (uint32_t i = 0U; i < cnt; i++) {
+		HAL_ETH_RxLinkCallback(&start, &end, s_buff[i], seg_len(i));
+		sum += seg_len(i);
+
+		struct pbuf *head = start;
+		CHECK(head == (struct pbuf *)(s_buff[0] - offsetof(RxBuff_t, buff)));
+		CHECK(head->tot_len == sum);
+		CHECK(end == (struct pbuf *)(s_buff[i] - offsetof(RxBuff_t, buff)));
+		/* Buffers after the head keep the length they were linked with,
+		 * nothing walked the chain */
+		struct pbuf *q = head->next;
+		for (uint32_t j = 1U; j <= i; j++, q = q->next) {
+			CHECK(q != NULL);
+			CHECK(q->tot_len == seg_len(j));
+		}
+		CHECK(q == NULL);
+	}
+
+	struct pbuf *p = start;
+	if (p->next != NULL) {
+		rx_chain_fixup(p);
+	}
+
+	/* pbuf chain invariants */
+	uint32_t left = sum;
+	uint32_t n = 0U;
+	for (struct pbuf *q = p; q != NULL; q = q->next, n++) {
+		CHECK(q->tot_len == left);
+		CHECK(q->len == seg_len(n));
+		CHECK(q->len <= q->tot_len);
+		CHECK((q->next != NULL) || (q->tot_len == q->len));
+		left -= q->len;
+	}
+	CHECK(n == cnt);
+	CHECK(left == 0U);
+
+	free_buffers(cnt);
+}
+
+static void test_single_buffer(void)
+{
+	check_frame(1U);
+}
+
+static void test_two_buffers(void)
+{
+	check_frame(2U);
+}
+
+static void test_long_chain(void)
+{
+	check_frame(CHAIN_MAX);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+/* Median TSC cycles to link the last of cnt buffers */
+static uint64_t link_cycles(uint32_t cnt)
+{
+	enum { REPEAT = 1001 };
+	static uint64_t samples[REPEAT];
+
+	alloc_buffers(cnt);
+	for (uint32_t r = 0U; r < REPEAT; r++) {
+		void *start = NULL;
+		void *end = NULL;
+		for (uint32_t i = 0U; i + 1U < cnt; i++) {
+			HAL_ETH_RxLinkCallback(&start, &end, s_buff[i], SEG_LEN);
+		}
+		uint64_t t0 = __rdtsc();
+		HAL_ETH_RxLinkCallback(&start, &end, s_buff[cnt - 1U], SEG_LEN);
+		samples[r] = __rdtsc() - t0;
+	}
+	free_buffers(cnt);
+
+	qsort(samples, REPEAT, sizeof(samples[0]), cmp_u64);
+	return samples[REPEAT / 2];
+}
+
+/* Appending to a long chain costs about the same as to a short one. A walk
+ * of the chain would make the 256th buffer ~128 times slower than the 2nd. */
+static void test_link_cycles(void)
+{
+	uint64_t c2 = link_cycles(2U);
+	uint64_t c256 = link_cycles(CHAIN_MAX);
+
+	printf("  link cycles: 2nd buffer %llu, %uth buffer %llu\n",
+	       (unsigned long long)c2, CHAIN_MAX, (unsigned long long)c256);
+	CHECK(c256 <= 4U * c2 + 100U);
+}
+
+int main(void)
+{
+	int failed = 0;
+
+	failed |= TEST_RUN(test_single_buffer);
+	failed |= TEST_RUN(test_two_buffers);
+	failed |= TEST_RUN(test_long_chain);
+	failed |= TEST_RUN(test_link_cycles);
+
+	return failed;
+}
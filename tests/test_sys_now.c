@@ -0,0 +1,93 @@
+/* sys_now() folds the 100 kHz TIM2 counter into milliseconds without drift:
+ * it never runs ahead of the counter and lags it by less than 1 ms, whatever
+ * the spacing of the calls, also across the counter wrap. */
+
+#include <stdio.h>
+
+/* The firmware main() ends in vTaskStartScheduler(), which the stub returns */
+#pragma GCC diagnostic ignored "-Wreturn-type"
+#define main firmware_main
+#include "../Src/main.c"
+#undef main
+
+#include "test.h"
+
+static TIM_TypeDef s_tim2;
+TIM_TypeDef *TIM2 = &s_tim2;
+
+/* Ticks since the first sys_now() call and its result. sys_now() keeps the
+ * sub-millisecond remainder between calls, so the tests share one reference. */
+static uint64_t s_ticks;
+static u32_t s_start_ms;
+static int s_started;
+
+/* Advances the counter by ticks and checks the time elapsed since the first
+ * call */
+static void advance(uint32_t ticks)
+{
+	if (!s_started) {
+		s_start_ms = sys_now();
+		s_started = 1;
+	}
+	s_tim2.CNT += ticks;
+	s_ticks += ticks;
+	uint64_t elapsed_ms = (u32_t)(sys_now() - s_start_ms);
+
+	CHECK(elapsed_ms * TIM2_TICKS_PER_MS <= s_ticks);
+	CHECK(s_ticks - elapsed_ms * TIM2_TICKS_PER_MS < TIM2_TICKS_PER_MS);
+}
+
+/* Moves the counter to cnt, by less than one TIM2 period */
+static void start(uint32_t cnt)
+{
+	advance(cnt - s_tim2.CNT);
+}
+
+static void test_every_tick(void)
+{
+	start(0U);
+	for (uint32_t i = 0U; i < 100000U; i++) {
+		advance(1U);
+	}
+}
+
+/* Calls at sub-millisecond intervals that don't divide a millisecond, as from
+ * the lwIP timers and TCP, would drift if each call rounded */
+static void test_sub_ms_calls(void)
+{
+	static const uint32_t steps[] = { 37U, 99U, 1U, 63U, 150U, 0U, 251U };
+
+	start(12345U);
+	for (uint32_t i = 0U; i < 100000U; i++) {
+		advance(steps[i % (sizeof(steps) / sizeof(steps[0]))]);
+	}
+}
+
+static void test_counter_wrap(void)
+{
+	start(0xFFFFFFFFUL - 1000U);
+	for (uint32_t i = 0U; i < 2000U; i++) {
+		advance(7U);
+	}
+}
+
+/* One call per TIM2 period is enough to keep the count */
+static void test_long_gap(void)
+{
+	start(42U);
+	advance(0xFFFFFFFFUL);
+	advance(50U);
+	advance(50U);
+}
+
+int main(void)
+{
+	int failed = 0;
+
+	failed |= TEST_RUN(test_every_tick);
+	failed |= TEST_RUN(test_sub_ms_calls);
+	failed |= TEST_RUN(test_counter_wrap);
+	failed |= TEST_RUN(test_long_gap);
+
+	return failed;
+}
@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+"""Decodes a dump of g_trace (Inc/trace.h) into latency histograms and a
+Chrome/Perfetto JSON trace.
+
+Dump the ring with gdb while the target is halted:
+
+    dump binary memory trace.bin &g_trace (char *)&g_trace + sizeof(g_trace)
+
+and decode it with:
+
+    tools/trace_decode.py trace.bin -o trace.json
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+TRACE_MAGIC = 0x45435254
+
+EVENTS = {
+    1: "rx_alloc",
+    2: "rx_link",
+    3: "rx_input",
+    4: "rx_free",
+    5: "tx_enter",
+    6: "tx_exit",
+    7: "mbox_post",
+    8: "mbox_fetch",
+    9: "rx_copy",
+}
+
+# (name, start event, end events, keyed by argument)
+# Short frames are copied to a small buffer before they are input, so their
+# driver span ends at rx_copy of the RX buffer and their stack span starts at
+# rx_input of the small buffer.
+SPANS = [
+    ("rx_dma", "rx_alloc", ("rx_link",), True),
+    ("rx_driver", "rx_link", ("rx_input", "rx_copy"), True),
+    ("rx_stack", "rx_input", ("rx_free",), True),
+    ("tx", "tx_enter", ("tx_exit",), False),
+    ("mbox", "mbox_post", ("mbox_fetch",), True),
+]
+
+
+def load(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    magic, size, hz, head = struct.unpack_from("<4I", data, 0)
+    if magic != TRACE_MAGIC:
+        sys.exit("%s: bad magic 0x%08x, trace_init() did not run" % (path, magic))
+    if len(data) < 16 + 8 * size:
+        sys.exit("%s: truncated, expected %d records" % (path, size))
+
+    count = min(head, size)
+    records = []
+    cycles = 0
+    prev = None
+    for n in range(head - count, head):
+        ts, ev = struct.unpack_from("<2I", data, 16 + 8 * (n % size))
+        if prev is not None:
+            # CYCCNT wraps, and a probe preempted between claiming its slot
+            # and reading the counter may be slightly behind its successor
+            delta = (ts - prev) & 0xFFFFFFFF
+            cycles += delta - (1 << 32) if delta & 0x80000000 else delta
+        prev = ts
+        records.append((cycles, EVENTS.get(ev >> 24, "id%d" % (ev >> 24)), ev & 0xFFFFFF))
+    return hz, records
+
+
+def spans(records):
+    """Yields (span, key, start, end) for every matched start/end pair"""
+    for name, begin, end, keyed in SPANS:
+        open_ = {}
+        for cycles, event, arg in records:
+            key = arg if keyed else 0
+            if event == begin:
+                open_[key] = cycles
+            elif event in end and key in open_:
+                yield name, key, open_.pop(key), cycles
+
+
+def histograms(hz, pairs):
+    by_span = {}
+    for name, _, start, end in pairs:
+        by_span.setdefault(name, []).append(end - start)
+
+    for name, _, _, _ in SPANS:
+        values = sorted(by_span.get(name, []))
+        if not values:
+            continue
+        us = 1e6 / hz
+        print("%s: %d samples, min %.2f us, median %.2f us, max %.2f us" % (
+            name, len(values), values[0] * us, values[len(values) // 2] * us, values[-1] * us))
+        buckets = {}
+        for v in values:
+            bit = max(v, 1).bit_length()
+            buckets[bit] = buckets.get(bit, 0) + 1
+        for bit in sorted(buckets):
+            bar = "#" * max(1, 50 * buckets[bit] // len(values))
+            print("  < %9.2f us %6d %s" % ((1 << bit) * us, buckets[bit], bar))
+
+
+def chrome_trace(hz, records, pairs):
+    us = 1e6 / hz
+    events = []
+    for cycles, event, arg in records:
+        events.append({"name": event, "ph": "i", "s": "t", "ts": cycles * us,
+                       "pid": 0, "tid": event, "args": {"arg": "0x%06x" % arg}})
+    for n, (name, key, start, end) in enumerate(pairs):
+        # Async events, spans of one kind overlap
+        ident = "%s-%d" % (name, n)
+        events.append({"name": name, "cat": name, "ph": "b", "id": ident, "ts": start * us,
+                       "pid": 0, "args": {"arg": "0x%06x" % key}})
+        events.append({"name": name, "cat": name, "ph": "e", "id": ident, "ts": end * us, "pid": 0})
+    return {"traceEvents": events, "displayTimeUnit": "ns"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("dump", help="binary dump of g_trace")
+    parser.add_argument("-o", "--output", help="write a Chrome/Perfetto JSON trace")
+    args = parser.parse_args()
+
+    hz, records = load(args.dump)
+    pairs = list(spans(records))
+    print("%d records at %d Hz" % (len(records), hz))
+    histograms(hz, pairs)
+
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(chrome_trace(hz, records, pairs), f)
+
+
+if __name__ == "__main__":
+    main()